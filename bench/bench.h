@@ -0,0 +1,88 @@
+#ifndef YARP_BENCH_H
+#define YARP_BENCH_H
+
+#include <yarp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The number of times each benchmark is run. The fastest run is reported,
+// since it's the one least disturbed by everything else on the machine.
+#define BENCH_RUNS 10
+
+static inline double
+bench_now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+// Lex the given source all the way through and return the number of tokens
+// that were found.
+static inline size_t
+bench_lex(const char *source, size_t size) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, source, size);
+
+  size_t count = 0;
+  do {
+    yp_lex_token(&parser);
+    count++;
+  } while (parser.current.type != YP_TOKEN_EOF);
+
+  yp_parser_free(&parser);
+  return count;
+}
+
+// Parse the given source and return the length of the root node, so that the
+// work can't be optimized away.
+static inline size_t
+bench_parse(const char *source, size_t size) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, source, size);
+
+  yp_node_t *node = yp_parse(&parser);
+  size_t result = (size_t) (node->location.end - node->location.start);
+
+  yp_node_destroy(&parser, node);
+  yp_parser_free(&parser);
+  return result;
+}
+
+// Run the given function over the source BENCH_RUNS times and print the
+// fastest time along with the throughput.
+#define BENCH(name, function, source, size) \
+  do { \
+    double best = 0; \
+    size_t result = 0; \
+    for (int run = 0; run < BENCH_RUNS; run++) { \
+      double start = bench_now(); \
+      result = function(source, size); \
+      double elapsed = bench_now() - start; \
+      if (run == 0 || elapsed < best) best = elapsed; \
+    } \
+    printf("%-32s %10.3f ms %10.1f MB/s (%zu)\n", name, best * 1e3, (double) (size) / best / 1e6, result); \
+  } while (0)
+
+// A small growable buffer for building up benchmark inputs.
+typedef struct {
+  char *value;
+  size_t length;
+  size_t capacity;
+} bench_source_t;
+
+static inline void
+bench_source_append(bench_source_t *source, const char *value) {
+  size_t length = strlen(value);
+
+  if (source->length + length + 1 > source->capacity) {
+    source->capacity = (source->capacity + length + 1) * 2;
+    source->value = realloc(source->value, source->capacity);
+  }
+
+  memcpy(source->value + source->length, value, length + 1);
+  source->length += length;
+}
+
+#endif
@@ -0,0 +1,134 @@
+// Lexes comment-heavy sources, which mostly exercise comment and whitespace
+// skipping in the default lex mode. The skipping is also timed on its own,
+// both with the byte-at-a-time loops that the lexer used to have and with the
+// bulk searches that replaced them, so that the two can be compared at the
+// same revision.
+
+#include "bench.h"
+
+// Skip past a word, which stands in for whatever token the lexer would find
+// there. This is the same for both ways of skipping, so it's only here to get
+// to the next run of whitespace or comment.
+static inline const char *
+skip_word(const char *cursor, const char *end) {
+  do {
+    cursor++;
+  } while (cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\n' && *cursor != '#');
+
+  return cursor;
+}
+
+// Skip whitespace and comments through the source the way lex_token_type did
+// before, one byte at a time. Returns the number of bytes that were skipped.
+static size_t
+skip_bytewise(const char *source, size_t size) {
+  const char *cursor = source;
+  const char *end = source + size;
+  size_t skipped = 0;
+
+  while (cursor < end) {
+    const char *start = cursor;
+
+    bool chomping = true;
+    while (chomping) {
+      switch (*cursor) {
+        case ' ':
+        case '\t':
+        case '\f':
+        case '\v':
+          cursor++;
+          break;
+        case '\r':
+          if (cursor[1] == '\n') {
+            chomping = false;
+          } else {
+            cursor++;
+          }
+          break;
+        default:
+          chomping = false;
+          break;
+      }
+    }
+
+    if (*cursor == '#') {
+      while (*cursor != '\n' && *cursor != '\0') {
+        cursor++;
+      }
+    }
+
+    skipped += (size_t) (cursor - start);
+    if (cursor < end) cursor = skip_word(cursor, end);
+  }
+
+  return skipped;
+}
+
+// Skip whitespace and comments through the source the way lex_token_type does
+// now, with yp_strspn_inline_whitespace and yp_strpbrk. Returns the number of
+// bytes that were skipped, which should match skip_bytewise.
+static size_t
+skip_bulk(const char *source, size_t size) {
+  const char *cursor = source;
+  const char *end = source + size;
+  size_t skipped = 0;
+
+  while (cursor < end) {
+    const char *start = cursor;
+    cursor += yp_strspn_inline_whitespace(cursor, end - cursor);
+
+    if (cursor < end && *cursor == '#') {
+      const char breakpoints[] = { '\n', '\0' };
+      const char *ending = yp_strpbrk(cursor, end - cursor, breakpoints, sizeof(breakpoints));
+      cursor = ending == NULL ? end : ending;
+    }
+
+    skipped += (size_t) (cursor - start);
+    if (cursor < end) cursor = skip_word(cursor, end);
+  }
+
+  return skipped;
+}
+
+// Time lexing the source, and then skipping its whitespace and comments both
+// ways.
+static void
+bench_comments(const char *name, const char *source, size_t size) {
+  char label[64];
+
+  snprintf(label, sizeof(label), "%s (lex)", name);
+  BENCH(label, bench_lex, source, size);
+  snprintf(label, sizeof(label), "%s (bytewise)", name);
+  BENCH(label, skip_bytewise, source, size);
+  snprintf(label, sizeof(label), "%s (bulk)", name);
+  BENCH(label, skip_bulk, source, size);
+}
+
+int
+main(void) {
+  bench_source_t license = { 0 };
+  bench_source_t indented = { 0 };
+  bench_source_t trailing = { 0 };
+
+  for (int index = 0; index < 20000; index++) {
+    // A long license header made up of full-line comments.
+    bench_source_append(&license, "# Permission is hereby granted, free of charge, to any person obtaining a copy\n");
+    bench_source_append(&license, "# of this software and associated documentation files (the \"Software\"), to deal\n");
+
+    // Deeply indented code with documentation comments in between.
+    bench_source_append(&indented, "                # Returns the value of the option with the given name.\n");
+    bench_source_append(&indented, "                value = options[name]\n");
+
+    // Short statements with trailing comments.
+    bench_source_append(&trailing, "foo = 1 # the first value\nbar = foo + 2   # the second value\n");
+  }
+
+  bench_comments("license header", license.value, license.length);
+  bench_comments("indented comments", indented.value, indented.length);
+  bench_comments("trailing comments", trailing.value, trailing.length);
+
+  free(license.value);
+  free(indented.value);
+  free(trailing.value);
+  return 0;
+}
@@ -0,0 +1,171 @@
+// Lexes identifier-heavy sources, which mostly exercise identifier scanning
+// and keyword recognition in lex_identifier. Keyword recognition is also timed
+// on its own over the words in each source, both with the chain of comparisons
+// that lex_identifier used to have and with the generated
+// yp_keyword_token_type that replaced it, so that the two can be compared at
+// the same revision.
+
+#include "bench.h"
+
+// The words that were found by lexing the source that's being benchmarked.
+typedef struct {
+  const char *start;
+  size_t length;
+} bench_word_t;
+
+static struct {
+  bench_word_t *values;
+  size_t size;
+  size_t capacity;
+} words;
+
+// Lex the source and keep every token that starts like an identifier, which
+// is every token that lex_identifier checks against the keywords. Returns the
+// total length of the words.
+static size_t
+collect_words(const char *source, size_t size) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, source, size);
+
+  words.size = 0;
+  size_t length = 0;
+
+  for (yp_lex_token(&parser); parser.current.type != YP_TOKEN_EOF; yp_lex_token(&parser)) {
+    char start = parser.current.start[0];
+    if (!(start == '_' || (start >= 'a' && start <= 'z') || (start >= 'A' && start <= 'Z'))) continue;
+
+    if (words.size == words.capacity) {
+      words.capacity = words.capacity == 0 ? 1024 : words.capacity * 2;
+      words.values = realloc(words.values, words.capacity * sizeof(bench_word_t));
+    }
+
+    size_t width = (size_t) (parser.current.end - parser.current.start);
+    words.values[words.size++] = (bench_word_t) { .start = parser.current.start, .length = width };
+    length += width;
+  }
+
+  yp_parser_free(&parser);
+  return length;
+}
+
+#define KEYWORD(value, token) \
+  if (width == sizeof(value) - 1 && strncmp(start, value, sizeof(value) - 1) == 0) \
+    return YP_TOKEN_KEYWORD_##token;
+
+// The comparisons that lex_identifier made against each keyword in turn before
+// keyword recognition was generated from config.yml.
+static yp_token_type_t
+keyword_chain(const char *start, size_t width) {
+  KEYWORD("defined?", DEFINED)
+  KEYWORD("__ENCODING__", __ENCODING__)
+  KEYWORD("__LINE__", __LINE__)
+  KEYWORD("__FILE__", __FILE__)
+  KEYWORD("alias", ALIAS)
+  KEYWORD("and", AND)
+  KEYWORD("begin", BEGIN)
+  KEYWORD("BEGIN", BEGIN_UPCASE)
+  KEYWORD("break", BREAK)
+  KEYWORD("case", CASE)
+  KEYWORD("class", CLASS)
+  KEYWORD("def", DEF)
+  KEYWORD("do", DO)
+  KEYWORD("else", ELSE)
+  KEYWORD("elsif", ELSIF)
+  KEYWORD("end", END)
+  KEYWORD("END", END_UPCASE)
+  KEYWORD("ensure", ENSURE)
+  KEYWORD("false", FALSE)
+  KEYWORD("for", FOR)
+  KEYWORD("if", IF)
+  KEYWORD("in", IN)
+  KEYWORD("module", MODULE)
+  KEYWORD("next", NEXT)
+  KEYWORD("nil", NIL)
+  KEYWORD("not", NOT)
+  KEYWORD("or", OR)
+  KEYWORD("redo", REDO)
+  KEYWORD("rescue", RESCUE)
+  KEYWORD("retry", RETRY)
+  KEYWORD("return", RETURN)
+  KEYWORD("self", SELF)
+  KEYWORD("super", SUPER)
+  KEYWORD("then", THEN)
+  KEYWORD("true", TRUE)
+  KEYWORD("undef", UNDEF)
+  KEYWORD("unless", UNLESS)
+  KEYWORD("until", UNTIL)
+  KEYWORD("when", WHEN)
+  KEYWORD("while", WHILE)
+  KEYWORD("yield", YIELD)
+  return YP_TOKEN_IDENTIFIER;
+}
+
+#undef KEYWORD
+
+// Recognize the keywords among the collected words with the old chain of
+// comparisons. The source is only there to match the BENCH signature, since
+// the words point into it already. Returns the number of keywords.
+static size_t
+recognize_chain(const char *source, size_t size) {
+  size_t count = 0;
+
+  for (size_t index = 0; index < words.size; index++) {
+    if (keyword_chain(words.values[index].start, words.values[index].length) != YP_TOKEN_IDENTIFIER) count++;
+  }
+
+  return count;
+}
+
+// Recognize the keywords among the collected words with yp_keyword_token_type.
+// Returns the number of keywords, which should match recognize_chain.
+static size_t
+recognize_generated(const char *source, size_t size) {
+  size_t count = 0;
+
+  for (size_t index = 0; index < words.size; index++) {
+    if (yp_keyword_token_type(words.values[index].start, words.values[index].length) != YP_TOKEN_IDENTIFIER) count++;
+  }
+
+  return count;
+}
+
+// Time lexing the source, and then recognizing the keywords among its words
+// both ways.
+static void
+bench_identifiers(const char *name, const char *source, size_t size) {
+  char label[64];
+
+  snprintf(label, sizeof(label), "%s (lex)", name);
+  BENCH(label, bench_lex, source, size);
+
+  size_t length = collect_words(source, size);
+  snprintf(label, sizeof(label), "%s (chain)", name);
+  BENCH(label, recognize_chain, source, length);
+  snprintf(label, sizeof(label), "%s (generated)", name);
+  BENCH(label, recognize_generated, source, length);
+}
+
+int
+main(void) {
+  bench_source_t identifiers = { 0 };
+  bench_source_t keywords = { 0 };
+
+  for (int index = 0; index < 20000; index++) {
+    // Method calls and local variables whose names are not keywords, which
+    // previously had to be compared against every keyword.
+    bench_source_append(&identifiers, "result = format_value options fetch_name element_count\n");
+    bench_source_append(&identifiers, "y = x if enabled_feature unless disabled_feature\n");
+
+    // Control flow that is mostly made up of keywords.
+    bench_source_append(&keywords, "while true do break if false end\n");
+    bench_source_append(&keywords, "begin yield self rescue retry ensure nil end\n");
+  }
+
+  bench_identifiers("identifiers", identifiers.value, identifiers.length);
+  bench_identifiers("keywords", keywords.value, keywords.length);
+
+  free(identifiers.value);
+  free(keywords.value);
+  free(words.values);
+  return 0;
+}
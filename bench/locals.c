@@ -0,0 +1,34 @@
+// Parses methods with hundreds of local variables, which mostly exercises
+// resolving identifiers against the locals of the current scope.
+
+#include "bench.h"
+
+int
+main(void) {
+  bench_source_t source = { 0 };
+  char line[128];
+
+  for (int method = 0; method < 50; method++) {
+    bench_source_append(&source, "def method\n");
+
+    // Declare a few hundred locals, each of which reads the previous one.
+    bench_source_append(&source, "  local0 = 0\n");
+    for (int local = 1; local < 500; local++) {
+      snprintf(line, sizeof(line), "  local%d = local%d + 1\n", local, local - 1);
+      bench_source_append(&source, line);
+    }
+
+    // Then read each of them back again.
+    for (int local = 0; local < 500; local++) {
+      snprintf(line, sizeof(line), "  local%d\n", local);
+      bench_source_append(&source, line);
+    }
+
+    bench_source_append(&source, "end\n");
+  }
+
+  BENCH("500 locals per method", bench_parse, source.value, source.length);
+
+  free(source.value);
+  return 0;
+}
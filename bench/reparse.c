@@ -0,0 +1,71 @@
+// Makes a one character edit in the middle of a file of about 10,000 lines and
+// compares parsing the whole file again against reparsing it incrementally.
+
+#include "bench.h"
+
+int
+main(void) {
+  bench_source_t source = { 0 };
+  char line[128];
+  size_t middle = 0;
+
+  bench_source_append(&source, "class Foo\n");
+
+  for (int method = 0; method < 1000; method++) {
+    if (method == 500) middle = source.length;
+
+    snprintf(line, sizeof(line), "  def method%d(a, b)\n", method);
+    bench_source_append(&source, line);
+    bench_source_append(&source, "    c = a + b\n");
+    bench_source_append(&source, "    d = c * 2\n");
+    bench_source_append(&source, "    puts(d)\n");
+    bench_source_append(&source, "    e = foo.bar(c)\n");
+    bench_source_append(&source, "    e\n");
+    bench_source_append(&source, "  end\n");
+    bench_source_append(&source, "\n");
+  }
+
+  bench_source_append(&source, "end\n");
+
+  // Type a character into the first line of the body of the method in the
+  // middle of the file.
+  size_t offset = middle + strlen("  def method500(a, b)\n    c = a");
+  yp_edit_t edit = { .start = (uint32_t) offset, .old_end = (uint32_t) offset, .new_end = (uint32_t) offset + 1 };
+
+  char *edited = malloc(source.length + 2);
+  memcpy(edited, source.value, offset);
+  edited[offset] = 'x';
+  memcpy(edited + offset + 1, source.value + offset, source.length - offset + 1);
+
+  BENCH("full parse after an edit", bench_parse, edited, source.length + 1);
+
+  double best = 0;
+  size_t result = 0;
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    yp_parser_t previous;
+    yp_parser_init(&previous, source.value, source.length);
+    yp_parser_enable_reparse(&previous);
+    yp_node_t *tree = yp_parse(&previous);
+
+    double start = bench_now();
+
+    yp_parser_t parser;
+    yp_parser_init(&parser, edited, source.length + 1);
+    tree = yp_reparse(&parser, &previous, tree, &edit);
+
+    double elapsed = bench_now() - start;
+    if (run == 0 || elapsed < best) best = elapsed;
+
+    result = (size_t) (tree->location.end - tree->location.start);
+    yp_parser_free(&previous);
+    yp_node_destroy(&parser, tree);
+    yp_parser_free(&parser);
+  }
+
+  printf("%-32s %10.3f ms %10.1f MB/s (%zu)\n", "reparse after an edit", best * 1e3, (double) (source.length + 1) / best / 1e6, result);
+
+  free(edited);
+  free(source.value);
+  return 0;
+}
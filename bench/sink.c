@@ -0,0 +1,60 @@
+// Serializes a large file to a buffer and to a file descriptor, which writes it
+// out a chunk at a time instead of holding all of it in memory.
+
+#include "bench.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+int
+main(void) {
+  bench_source_t methods = { 0 };
+  char line[128];
+
+  bench_source_append(&methods, "class Foo\n");
+
+  for (int method = 0; method < 10000; method++) {
+    snprintf(line, sizeof(line), "  def method%d(a, b)\n", method);
+    bench_source_append(&methods, line);
+    bench_source_append(&methods, "    c = a + b\n");
+    bench_source_append(&methods, "    puts(foo.bar(c, [1, 2, 3]))\n");
+    bench_source_append(&methods, "  end\n\n");
+  }
+
+  bench_source_append(&methods, "end\n");
+
+  yp_parser_t parser;
+  yp_parser_init(&parser, methods.value, methods.length);
+  yp_node_t *node = yp_parse(&parser);
+
+  int fd = open("/dev/null", O_WRONLY);
+  double best_buffer = 0;
+  double best_fd = 0;
+  size_t capacity = 0;
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    yp_buffer_t buffer;
+    yp_buffer_init(&buffer);
+
+    double start = bench_now();
+    yp_serialize(&parser, node, &buffer);
+    double buffered = bench_now();
+    yp_serialize_to_fd(&parser, node, fd, 0);
+    double written = bench_now();
+
+    if (run == 0 || buffered - start < best_buffer) best_buffer = buffered - start;
+    if (run == 0 || written - buffered < best_fd) best_fd = written - buffered;
+
+    capacity = buffer.capacity;
+    yp_buffer_free(&buffer);
+  }
+
+  printf("%-32s %10.3f ms %10zu bytes held\n", "serialize to a buffer", best_buffer * 1e3, capacity);
+  printf("%-32s %10.3f ms %10d bytes per chunk\n", "serialize to a file descriptor", best_fd * 1e3, YP_SERIALIZE_CHUNK_SIZE);
+
+  close(fd);
+  yp_node_destroy(&parser, node);
+  yp_parser_free(&parser);
+  free(methods.value);
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Serializes and destroys a typical file and a deeply nested expression, which
+// exercises walking trees with an explicit stack. Each is timed against the
+// recursive walks that the explicit stacks replaced, which the library only
+// builds with YP_BENCH.
+
+#include "bench.h"
+
+// A way of walking a tree to serialize it and then destroy it.
+typedef struct {
+  const char *name;
+  void (*serialize)(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer);
+  void (*destroy)(yp_parser_t *parser, yp_node_t *node);
+} bench_walk_t;
+
+static void
+serialize_explicit(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer) {
+  yp_serialize_node(parser, node, buffer, 0);
+}
+
+static const bench_walk_t walks[] = {
+  { .name = "recursive", .serialize = yp_serialize_node_recursive, .destroy = yp_node_destroy_recursive },
+  { .name = "explicit stack", .serialize = serialize_explicit, .destroy = yp_node_destroy }
+};
+
+// Time serializing and then destroying the tree for the given source with the
+// given walk, leaving parsing out of it, and print the fastest of each.
+static void
+bench_traverse(const bench_walk_t *walk, const char *name, const char *source, size_t size) {
+  double best_serialize = 0;
+  double best_destroy = 0;
+  size_t result = 0;
+
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    yp_parser_t parser;
+    yp_parser_init(&parser, source, size);
+    yp_node_t *node = yp_parse(&parser);
+
+    yp_buffer_t buffer;
+    yp_buffer_init(&buffer);
+
+    double start = bench_now();
+    walk->serialize(&parser, node, &buffer);
+    double serialized = bench_now();
+    walk->destroy(&parser, node);
+    double destroyed = bench_now();
+
+    if (run == 0 || serialized - start < best_serialize) best_serialize = serialized - start;
+    if (run == 0 || destroyed - serialized < best_destroy) best_destroy = destroyed - serialized;
+
+    result = buffer.length;
+    yp_buffer_free(&buffer);
+    yp_parser_free(&parser);
+  }
+
+  char label[64];
+  snprintf(label, sizeof(label), "serialize %s (%s)", name, walk->name);
+  printf("%-48s %10.3f ms %10.1f MB/s (%zu)\n", label, best_serialize * 1e3, (double) size / best_serialize / 1e6, result);
+  snprintf(label, sizeof(label), "destroy %s (%s)", name, walk->name);
+  printf("%-48s %10.3f ms %10.1f MB/s (%zu)\n", label, best_destroy * 1e3, (double) size / best_destroy / 1e6, result);
+}
+
+// Run every walk over the given source.
+static void
+bench_traverse_all(const char *name, const char *source, size_t size) {
+  for (size_t index = 0; index < sizeof(walks) / sizeof(walks[0]); index++) {
+    bench_traverse(&walks[index], name, source, size);
+  }
+}
+
+int
+main(void) {
+  bench_source_t methods = { 0 };
+  char line[128];
+
+  bench_source_append(&methods, "class Foo\n");
+
+  for (int method = 0; method < 1000; method++) {
+    snprintf(line, sizeof(line), "  def method%d(a, b)\n", method);
+    bench_source_append(&methods, line);
+    bench_source_append(&methods, "    c = a + b\n");
+    bench_source_append(&methods, "    puts(foo.bar(c, [1, 2, 3]))\n");
+    bench_source_append(&methods, "  end\n\n");
+  }
+
+  bench_source_append(&methods, "end\n");
+  bench_traverse_all("methods", methods.value, methods.length);
+
+  // A left-associative chain of calls nests each call in the receiver of the
+  // next one, so the tree is as deep as the chain is long.
+  bench_source_t chain = { 0 };
+  bench_source_append(&chain, "1");
+
+  for (int term = 0; term < 10000; term++) {
+    bench_source_append(&chain, " + 1");
+  }
+
+  bench_source_append(&chain, "\n");
+  bench_traverse_all("10,000 nested calls", chain.value, chain.length);
+
+  free(methods.value);
+  free(chain.value);
+  return 0;
+}
@@ -0,0 +1,26 @@
+// Lexes sources with non-ASCII identifiers, which mostly exercises the Unicode
+// character classification used by the UTF-8 encoding.
+
+#include "bench.h"
+
+int
+main(void) {
+  bench_source_t latin = { 0 };
+  bench_source_t cyrillic = { 0 };
+  bench_source_t cjk = { 0 };
+
+  for (int index = 0; index < 20000; index++) {
+    bench_source_append(&latin, "größe = maß * naïve_faktor + café_preis\n");
+    bench_source_append(&cyrillic, "результат = значение * множитель + смещение\n");
+    bench_source_append(&cjk, "結果 = 値段 * 数量 + 送料\n");
+  }
+
+  BENCH("latin", bench_lex, latin.value, latin.length);
+  BENCH("cyrillic", bench_lex, cyrillic.value, cyrillic.length);
+  BENCH("cjk", bench_lex, cjk.value, cjk.length);
+
+  free(latin.value);
+  free(cyrillic.value);
+  free(cjk.value);
+  return 0;
+}
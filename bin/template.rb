@@ -114,6 +114,11 @@ class NodeType
     @location_provided
   end
 
+  # The name of the C struct that represents this node.
+  def c_type
+    "yp_#{human}_t"
+  end
+
   private
 
   def start_location_for(params)
@@ -145,12 +150,22 @@ end
 # config.yml file for now, but this will probably change as we transition to
 # storing semantic strings instead of the lexer tokens.
 class Token
-  attr_reader :name, :value, :comment
+  attr_reader :name, :value, :comment, :keyword
 
   def initialize(config)
     @name = config.fetch("name")
     @value = config["value"]
     @comment = config.fetch("comment")
+    @keyword = config["keyword"]
+
+    if name.start_with?("KEYWORD_") && !keyword
+      raise "#{name} needs a keyword: key with the text of the keyword"
+    end
+  end
+
+  # Keyword tokens hold the text of the keyword that the lexer recognizes.
+  def keyword?
+    !keyword.nil?
   end
 
   def declaration
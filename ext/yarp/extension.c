@@ -7,6 +7,29 @@ VALUE rb_cYARPLocation;
 VALUE rb_cYARPComment;
 VALUE rb_cYARPParseError;
 VALUE rb_cYARPParseResult;
+VALUE rb_cYARPNewlineList;
+VALUE rb_cYARPLazyTree;
+
+static ID id_start_offset;
+static ID id_end_offset;
+static ID id_mapping;
+
+// Build a Location directly, without going through Location#initialize.
+static VALUE
+location_new(uint32_t start, uint32_t end) {
+  VALUE location = rb_obj_alloc(rb_cYARPLocation);
+  rb_ivar_set(location, id_start_offset, ULONG2NUM(start));
+  rb_ivar_set(location, id_end_offset, ULONG2NUM(end));
+  return location;
+}
+
+// Build a Location from a start and end offset packed into one integer, as
+// nodes and tokens hold them.
+static VALUE
+location_unpack(VALUE self, VALUE packed) {
+  unsigned long long value = NUM2ULL(packed);
+  return location_new((uint32_t) (value >> 32), (uint32_t) value);
+}
 
 // Represents a source of Ruby code. It can either be coming from a file or a
 // string. If it's a file, it's going to mmap the contents of the file. If it's
@@ -17,12 +40,13 @@ typedef struct {
   size_t size;
 } source_t;
 
-// Read the file indicated by the filepath parameter into source and load its
-// contents and size into the given source_t.
-int
-source_file_load(source_t *source, VALUE filepath) {
+// Read the file at the given path into source and load its contents and size
+// into the given source_t. This doesn't touch any Ruby objects, so it can be
+// called without holding the GVL.
+static int
+source_file_open(source_t *source, const char *filepath) {
   // Open the file for reading
-  int fd = open(StringValueCStr(filepath), O_RDONLY);
+  int fd = open(filepath, O_RDONLY);
   if (fd == -1) {
     perror("open");
     return 1;
@@ -36,12 +60,21 @@ source_file_load(source_t *source, VALUE filepath) {
     return 1;
   }
 
-  // mmap the file descriptor to virtually get the contents
+  // mmap can't map an empty file, so point empty files at an empty string
+  source->type = SOURCE_FILE;
   source->size = sb.st_size;
+
+  if (source->size == 0) {
+    close(fd);
+    source->source = "";
+    return 0;
+  }
+
+  // mmap the file descriptor to virtually get the contents
   source->source = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, fd, 0);
 
   close(fd);
-  if (source == MAP_FAILED) {
+  if (source->source == MAP_FAILED) {
     perror("mmap");
     return 1;
   }
@@ -49,7 +82,17 @@ source_file_load(source_t *source, VALUE filepath) {
   return 0;
 }
 
-// Load the contents and size of the given string into the given source_t.
+// Read the file indicated by the filepath parameter into source and load its
+// contents and size into the given source_t.
+int
+source_file_load(source_t *source, VALUE filepath) {
+  return source_file_open(source, StringValueCStr(filepath));
+}
+
+// Load the contents and size of the given string into the given source_t. The
+// GVL is released while parsing, so callers pass a frozen string (from
+// rb_str_new_frozen) so that other threads can't change the contents out from
+// under the parser.
 void
 source_string_load(source_t *source, VALUE string) {
   *source = (source_t) {
@@ -62,44 +105,326 @@ source_string_load(source_t *source, VALUE string) {
 // Free any resources associated with the given source_t.
 void
 source_file_unload(source_t *source) {
-  munmap((void *) source->source, source->size);
+  if (source->size != 0) munmap((void *) source->source, source->size);
+}
+
+/******************************************************************************/
+/* Mapped files                                                               */
+/******************************************************************************/
+
+static void
+mapping_free(void *data) {
+  source_file_unload((source_t *) data);
+  xfree(data);
 }
 
-// Dump the AST corresponding to the given source to a string.
+static size_t
+mapping_memsize(const void *data) {
+  return sizeof(source_t);
+}
+
+// The mapping behind a string returned by map_file, which unmaps the file when
+// it's collected.
+static const rb_data_type_t mapping_type = {
+  .wrap_struct_name = "YARP::Mapping",
+  .function = { .dmark = NULL, .dfree = mapping_free, .dsize = mapping_memsize },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+// Map the file at the given path and return a frozen binary string that points
+// at the mapping, so that the contents are only read from disk as they're
+// used. The mapping is held by the string in a hidden instance variable. The
+// string is frozen, so any string that shares its contents keeps it (and so
+// the mapping) alive. The file must not be truncated while the string is in
+// use, so this is only for files that are replaced by renaming over them.
+// Raises a SystemCallError if the file can't be mapped.
 static VALUE
-dump_source(source_t *source) {
-  yp_parser_t parser;
-  yp_parser_init(&parser, source->source, source->size);
+map_file(VALUE self, VALUE filepath) {
+  const char *path = StringValueCStr(filepath);
+
+  source_t *source;
+  VALUE mapping = TypedData_Make_Struct(0, source_t, &mapping_type, source);
+  *source = (source_t) { .type = SOURCE_FILE, .source = "", .size = 0 };
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) rb_sys_fail_str(filepath);
+
+  // A directory can be opened, but mapping it fails with a less helpful error.
+  struct stat sb;
+  int error = fstat(fd, &sb) == -1 ? errno : (S_ISDIR(sb.st_mode) ? EISDIR : 0);
+
+  if (error != 0) {
+    close(fd);
+    errno = error;
+    rb_sys_fail_str(filepath);
+  }
+
+  // mmap can't map an empty file, so empty files are left as an empty string.
+  if (sb.st_size != 0) {
+    void *contents = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-  yp_node_t *node = yp_parse(&parser);
+    if (contents == MAP_FAILED) {
+      error = errno;
+      close(fd);
+      errno = error;
+      rb_sys_fail_str(filepath);
+    }
+
+    source->source = contents;
+    source->size = (size_t) sb.st_size;
+  }
+
+  close(fd);
+
+  VALUE string = rb_str_new_static(source->source, (long) source->size);
+  rb_ivar_set(string, id_mapping, mapping);
+  return rb_obj_freeze(string);
+}
+
+// Parsing and serializing never touch Ruby objects, so the functions below are
+// run through rb_thread_call_without_gvl so that other threads can run while
+// they're working.
+static void *
+parse_without_gvl(void *data) {
+  return yp_parse((yp_parser_t *) data);
+}
+
+// Ruby calls this while the thread is parsing without the GVL if the thread is
+// interrupted (by Thread#raise, Timeout, or a signal like Ctrl-C), so that a
+// long parse stops at the next token. Whatever was being built is then freed
+// and the interrupt is handled with rb_thread_check_ints. Not every interrupt
+// raises (a trap handler can just return, for example), so if it returns then
+// the work is started again from the beginning.
+static void
+parser_cancel(void *data) {
+  yp_parser_cancel((yp_parser_t *) data);
+}
+
+// Parse the source without the GVL, starting over if it's interrupted (see
+// parser_cancel). The parser is initialized here.
+static yp_node_t *
+parse_run(yp_parser_t *parser, source_t *source) {
+  while (true) {
+    yp_parser_init(parser, source->source, source->size);
+    yp_node_t *node = rb_thread_call_without_gvl(parse_without_gvl, parser, parser_cancel, parser);
+    if (!parser->cancelled) return node;
+
+    yp_node_destroy(parser, node);
+    yp_parser_free(parser);
+    rb_thread_check_ints();
+  }
+}
+
+typedef struct {
+  yp_parser_t parser;
   yp_buffer_t buffer;
+  uint8_t flags;
+  VALUE string;
+  int state; // the tag of the exception raised while growing the String, if any
+} dump_t;
 
-  yp_buffer_init(&buffer);
-  yp_serialize(&parser, node, &buffer);
-  VALUE dumped = rb_str_new(buffer.value, buffer.length);
+static void *
+dump_without_gvl(void *data) {
+  dump_t *dump = (dump_t *) data;
 
-  yp_node_destroy(&parser, node);
-  yp_buffer_free(&buffer);
-  yp_parser_free(&parser);
+  yp_node_t *node = yp_parse(&dump->parser);
+  yp_serialize_with_flags(&dump->parser, node, &dump->buffer, dump->flags);
+  yp_node_destroy(&dump->parser, node);
+
+  return NULL;
+}
+
+// Build the NewlineList holding the offsets of the starts of the lines that the
+// given parser found.
+static VALUE
+newline_list_new(yp_parser_t *parser) {
+  yp_newline_list_t *list = &parser->newline_list;
+  VALUE offsets = rb_ary_new_capa((long) list->size);
 
-  return dumped;
+  for (size_t index = 0; index < list->size; index++) {
+    rb_ary_push(offsets, ULONG2NUM(list->offsets[index]));
+  }
+
+  return rb_class_new_instance(1, &offsets, rb_cYARPNewlineList);
+}
+
+typedef struct {
+  yp_parser_t parser;
+  yp_token_t *tokens;
+  size_t size;
+  size_t capacity;
+} lex_t;
+
+static void *
+lex_without_gvl(void *data) {
+  lex_t *lex = (lex_t *) data;
+  yp_parser_t *parser = &lex->parser;
+
+  for (yp_lex_token(parser); parser->current.type != YP_TOKEN_EOF; yp_lex_token(parser)) {
+    if (lex->size == lex->capacity) {
+      lex->capacity = lex->capacity == 0 ? 256 : lex->capacity * 2;
+      lex->tokens = realloc(lex->tokens, lex->capacity * sizeof(yp_token_t));
+    }
+
+    lex->tokens[lex->size++] = parser->current;
+  }
+
+  return NULL;
+}
+
+// Lex the source without the GVL, starting over if it's interrupted (see
+// parser_cancel). The lex_t is initialized here.
+static void
+lex_run(lex_t *lex, source_t *source) {
+  while (true) {
+    *lex = (lex_t) { .tokens = NULL, .size = 0, .capacity = 0 };
+    yp_parser_init(&lex->parser, source->source, source->size);
+    rb_thread_call_without_gvl(lex_without_gvl, lex, parser_cancel, &lex->parser);
+    if (!lex->parser.cancelled) return;
+
+    free(lex->tokens);
+    yp_parser_free(&lex->parser);
+    rb_thread_check_ints();
+  }
+}
+
+typedef struct {
+  yp_buffer_t *buffer;
+  size_t capacity;
+} dump_grow_t;
+
+// Grow the String that a dump is being written into. Whatever has been written
+// so far is made part of the String first so that it's kept when the String's
+// memory is reallocated.
+static VALUE
+dump_grow_protected(VALUE data) {
+  dump_grow_t *grow = (dump_grow_t *) data;
+  yp_buffer_t *buffer = grow->buffer;
+  VALUE string = ((dump_t *) buffer->data)->string;
+
+  rb_str_set_len(string, (long) buffer->length);
+  rb_str_modify_expand(string, (long) (grow->capacity - buffer->length));
+
+  buffer->value = RSTRING_PTR(string);
+  buffer->capacity = rb_str_capacity(string);
+  return Qnil;
+}
+
+// Growing the String can raise (say if there's no memory left), and jumping
+// out of here would skip freeing the parser and the serializer's state. So the
+// exception is caught and its tag is kept for dump_source to raise again once
+// everything has been freed.
+static void *
+dump_grow_with_gvl(void *data) {
+  dump_grow_t *grow = (dump_grow_t *) data;
+  rb_protect(dump_grow_protected, (VALUE) grow, &((dump_t *) grow->buffer->data)->state);
+  return NULL;
+}
+
+// The buffer for a dump grows while the GVL is released, so it takes the GVL
+// back for just long enough to grow the String. Returns false if the String
+// couldn't grow, which stops the serializer.
+static bool
+dump_grow(yp_buffer_t *buffer, size_t capacity) {
+  dump_t *dump = (dump_t *) buffer->data;
+  if (dump->state != 0) return false;
+
+  dump_grow_t grow = { .buffer = buffer, .capacity = capacity };
+  rb_thread_call_with_gvl(dump_grow_with_gvl, &grow);
+  return dump->state == 0;
+}
+
+// Dump the AST corresponding to the given source to a string, with the given
+// yp_serialize_flags_t values. The tree is serialized straight into the memory
+// of the String that's returned, rather than into a buffer that's copied into
+// a String afterward. It starts out the size of the source, and the allocator
+// can usually grow a large String in place rather than copying it.
+static VALUE
+dump_source(source_t *source, uint8_t flags) {
+  dump_t dump = { .flags = flags, .string = rb_str_buf_new((long) source->size), .state = 0 };
+
+  // If this is interrupted, then it starts over from the beginning of the
+  // String (see parser_cancel).
+  while (true) {
+    yp_parser_init(&dump.parser, source->source, source->size);
+
+    dump.buffer = (yp_buffer_t) {
+      .value = RSTRING_PTR(dump.string),
+      .length = 0,
+      .capacity = rb_str_capacity(dump.string),
+      .grow = dump_grow,
+      .data = &dump,
+      .failed = false
+    };
+
+    rb_thread_call_without_gvl(dump_without_gvl, &dump, parser_cancel, &dump.parser);
+    bool cancelled = dump.parser.cancelled;
+    yp_parser_free(&dump.parser);
+
+    // The serializer stopped early and freed what it was using, so now the
+    // exception from growing the String can be raised.
+    if (dump.state != 0) rb_jump_tag(dump.state);
+
+    if (!cancelled) break;
+    rb_thread_check_ints();
+  }
+
+  // If the source was much larger than the tree, give the rest of the memory
+  // back instead of holding on to it for as long as the String lives.
+  if (dump.buffer.capacity > dump.buffer.length * 2 + 1024) {
+    rb_str_resize(dump.string, (long) dump.buffer.length);
+  } else {
+    rb_str_set_len(dump.string, (long) dump.buffer.length);
+  }
+
+  return dump.string;
+}
+
+// Read the serialization flags out of the keyword arguments to dump and
+// dump_file. The only one is newlines:, which writes the starts of the lines
+// into the header.
+static uint8_t
+dump_flags(VALUE options) {
+  uint8_t flags = 0;
+
+  if (!NIL_P(options)) {
+    ID keywords[] = { rb_intern("newlines") };
+    VALUE values[1];
+    rb_get_kwargs(options, keywords, 0, 1, values);
+    if (values[0] != Qundef && RTEST(values[0])) flags |= YP_SERIALIZE_NEWLINES;
+  }
+
+  return flags;
 }
 
 // Dump the AST corresponding to the given string to a string.
 static VALUE
-dump(VALUE self, VALUE string) {
+dump(int argc, VALUE *argv, VALUE self) {
+  VALUE string, options;
+  rb_scan_args(argc, argv, "1:", &string, &options);
+  uint8_t flags = dump_flags(options);
+
+  string = rb_str_new_frozen(string);
+
   source_t source;
   source_string_load(&source, string);
-  return dump_source(&source);
+  VALUE value = dump_source(&source, flags);
+
+  RB_GC_GUARD(string);
+  return value;
 }
 
 // Dump the AST corresponding to the given file to a string.
 static VALUE
-dump_file(VALUE self, VALUE filepath) {
+dump_file(int argc, VALUE *argv, VALUE self) {
+  VALUE filepath, options;
+  rb_scan_args(argc, argv, "1:", &filepath, &options);
+  uint8_t flags = dump_flags(options);
+
   source_t source;
   if (source_file_load(&source, filepath) != 0) return Qnil;
 
-  VALUE value = dump_source(&source);
+  VALUE value = dump_source(&source, flags);
   source_file_unload(&source);
   return value;
 }
@@ -107,24 +432,30 @@ dump_file(VALUE self, VALUE filepath) {
 // Return an array of tokens corresponding to the given source.
 static VALUE
 lex_source(source_t *source) {
-  yp_parser_t parser;
-  yp_parser_init(&parser, source->source, source->size);
+  lex_t lex;
+  lex_run(&lex, source);
 
-  VALUE ary = rb_ary_new();
-  for (yp_lex_token(&parser); parser.current.type != YP_TOKEN_EOF; yp_lex_token(&parser)) {
-    rb_ary_push(ary, yp_token_new(&parser, &parser.current));
+  VALUE ary = rb_ary_new_capa((long) lex.size);
+  for (size_t index = 0; index < lex.size; index++) {
+    rb_ary_push(ary, yp_token_new(&lex.parser, &lex.tokens[index]));
   }
 
-  yp_parser_free(&parser);
+  free(lex.tokens);
+  yp_parser_free(&lex.parser);
   return ary;
 }
 
 // Return an array of tokens corresponding to the given string.
 static VALUE
 lex(VALUE self, VALUE string) {
+  string = rb_str_new_frozen(string);
+
   source_t source;
   source_string_load(&source, string);
-  return lex_source(&source);
+  VALUE value = lex_source(&source);
+
+  RB_GC_GUARD(string);
+  return value;
 }
 
 // Return an array of tokens corresponding to the given file.
@@ -138,18 +469,81 @@ lex_file(VALUE self, VALUE filepath) {
   return value;
 }
 
+// Return a binary string holding the type, start offset, and end offset of
+// each token in the given source as three native-endian 32-bit integers. If
+// newlines is set, then return an array of that string and the NewlineList that
+// was recorded while lexing instead.
 static VALUE
-parse_source(source_t *source) {
-  yp_parser_t parser;
-  yp_parser_init(&parser, source->source, source->size);
+lex_packed_source(source_t *source, bool newlines) {
+  lex_t lex;
+  lex_run(&lex, source);
+
+  VALUE packed = rb_str_new(NULL, (long) (lex.size * 3 * sizeof(uint32_t)));
+  uint32_t *values = (uint32_t *) RSTRING_PTR(packed);
+
+  for (size_t index = 0; index < lex.size; index++) {
+    yp_token_t *token = &lex.tokens[index];
+    values[index * 3] = (uint32_t) token->type;
+    values[index * 3 + 1] = (uint32_t) (token->start - lex.parser.start);
+    values[index * 3 + 2] = (uint32_t) (token->end - lex.parser.start);
+  }
+
+  if (newlines) packed = rb_assoc_new(packed, newline_list_new(&lex.parser));
+
+  free(lex.tokens);
+  yp_parser_free(&lex.parser);
+  return packed;
+}
+
+// Return the tokens corresponding to the given string, packed into a binary
+// string (see lex_packed_source).
+static VALUE
+lex_packed(VALUE self, VALUE string) {
+  string = rb_str_new_frozen(string);
+
+  source_t source;
+  source_string_load(&source, string);
+  VALUE value = lex_packed_source(&source, false);
+
+  RB_GC_GUARD(string);
+  return value;
+}
+
+// Return the tokens corresponding to the given file, packed into a binary
+// string (see lex_packed_source).
+static VALUE
+lex_file_packed(VALUE self, VALUE filepath) {
+  source_t source;
+  if (source_file_load(&source, filepath) != 0) return Qnil;
+
+  VALUE value = lex_packed_source(&source, false);
+  source_file_unload(&source);
+  return value;
+}
+
+// Return the tokens corresponding to the given string packed into a binary
+// string, along with the starts of the lines that were found while lexing.
+static VALUE
+lex_packed_with_newlines(VALUE self, VALUE string) {
+  string = rb_str_new_frozen(string);
+
+  source_t source;
+  source_string_load(&source, string);
+  VALUE value = lex_packed_source(&source, true);
+
+  RB_GC_GUARD(string);
+  return value;
+}
 
-  yp_node_t *node = yp_parse(&parser);
+// Build the ParseResult for the given parser and the Ruby object for the tree
+// that it parsed.
+static VALUE
+parse_result_new(yp_parser_t *parser, VALUE node) {
   VALUE comments = rb_ary_new();
   VALUE errors = rb_ary_new();
 
-  for (yp_comment_t *comment = (yp_comment_t *) parser.comment_list.head; comment != NULL;
+  for (yp_comment_t *comment = (yp_comment_t *) parser->comment_list.head; comment != NULL;
        comment = (yp_comment_t *) comment->node.next) {
-    VALUE location_argv[] = { LONG2FIX(comment->node.start), LONG2FIX(comment->node.end) };
     VALUE type;
 
     switch (comment->type) {
@@ -167,22 +561,27 @@ parse_source(source_t *source) {
         break;
     }
 
-    VALUE comment_argv[] = { type, rb_class_new_instance(2, location_argv, rb_cYARPLocation) };
+    VALUE comment_argv[] = { type, location_new(comment->node.start, comment->node.end) };
     rb_ary_push(comments, rb_class_new_instance(2, comment_argv, rb_cYARPComment));
   }
 
-  for (yp_error_t *error = (yp_error_t *) parser.error_list.head; error != NULL;
+  for (yp_error_t *error = (yp_error_t *) parser->error_list.head; error != NULL;
        error = (yp_error_t *) error->node.next) {
-    VALUE location_argv[] = { LONG2FIX(error->node.start), LONG2FIX(error->node.end) };
-
     VALUE error_argv[] = { rb_str_new(yp_string_source(&error->message), yp_string_length(&error->message)),
-                           rb_class_new_instance(2, location_argv, rb_cYARPLocation) };
+                           location_new(error->node.start, error->node.end) };
 
     rb_ary_push(errors, rb_class_new_instance(2, error_argv, rb_cYARPParseError));
   }
 
-  VALUE result_argv[] = { yp_node_new(&parser, node), comments, errors };
-  VALUE result = rb_class_new_instance(3, result_argv, rb_cYARPParseResult);
+  VALUE result_argv[] = { node, comments, errors, newline_list_new(parser) };
+  return rb_class_new_instance(4, result_argv, rb_cYARPParseResult);
+}
+
+static VALUE
+parse_source(source_t *source) {
+  yp_parser_t parser;
+  yp_node_t *node = parse_run(&parser, source);
+  VALUE result = parse_result_new(&parser, yp_node_new(&parser, node));
 
   yp_node_destroy(&parser, node);
   yp_parser_free(&parser);
@@ -192,9 +591,14 @@ parse_source(source_t *source) {
 
 static VALUE
 parse(VALUE self, VALUE string) {
+  string = rb_str_new_frozen(string);
+
   source_t source;
   source_string_load(&source, string);
-  return parse_source(&source);
+  VALUE value = parse_source(&source);
+
+  RB_GC_GUARD(string);
+  return value;
 }
 
 static VALUE
@@ -209,6 +613,426 @@ parse_file(VALUE self, VALUE rb_filepath) {
   return value;
 }
 
+// A lazy tree keeps the parser and the C tree that it parsed alive for as long
+// as any of the lazy nodes built from it are reachable. Those nodes ask it for
+// their fields the first time they're accessed, so only the parts of the tree
+// that are actually looked at are ever turned into Ruby objects.
+//
+// Lazy nodes refer to their C node by its index in the tree's table of nodes
+// rather than by its address, so that nothing that's passed back in from Ruby
+// is ever dereferenced without being checked first.
+typedef struct {
+  source_t source;
+  VALUE string;
+  yp_parser_t parser;
+  yp_node_t *node;
+  struct {
+    yp_node_t **values;
+    size_t size;
+    size_t capacity;
+  } nodes;
+} lazy_tree_t;
+
+static void
+lazy_tree_mark(void *data) {
+  rb_gc_mark(((lazy_tree_t *) data)->string);
+}
+
+static void
+lazy_tree_free(void *data) {
+  lazy_tree_t *tree = (lazy_tree_t *) data;
+
+  if (tree->node != NULL) {
+    yp_node_destroy(&tree->parser, tree->node);
+    yp_parser_free(&tree->parser);
+  }
+
+  if (tree->source.type == SOURCE_FILE) source_file_unload(&tree->source);
+  free(tree->nodes.values);
+  xfree(tree);
+}
+
+static size_t
+lazy_tree_memsize(const void *data) {
+  return sizeof(lazy_tree_t) + ((const lazy_tree_t *) data)->nodes.capacity * sizeof(yp_node_t *);
+}
+
+static const rb_data_type_t lazy_tree_type = {
+  .wrap_struct_name = "YARP::LazyTree",
+  .function = { .dmark = lazy_tree_mark, .dfree = lazy_tree_free, .dsize = lazy_tree_memsize },
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+// Parse the given source into a lazy tree and return a ParseResult whose node
+// is built lazily. The lazy tree takes ownership of the source. If the source
+// came from a string then that string is kept alive as well, and it should be
+// frozen so that it can't change underneath the tree.
+static VALUE
+parse_lazy_source(source_t *source, VALUE string) {
+  lazy_tree_t *tree;
+  VALUE owner = TypedData_Make_Struct(rb_cYARPLazyTree, lazy_tree_t, &lazy_tree_type, tree);
+
+  tree->source = *source;
+  tree->string = string;
+
+  tree->node = parse_run(&tree->parser, source);
+
+  return parse_result_new(&tree->parser, yp_node_lazy_new(&tree->parser, tree->node, owner));
+}
+
+// Add a node to the table of the given lazy tree and return its index, which
+// is what the lazy node for it holds as its position.
+VALUE
+yp_lazy_tree_position(VALUE owner, yp_node_t *node) {
+  lazy_tree_t *tree;
+  TypedData_Get_Struct(owner, lazy_tree_t, &lazy_tree_type, tree);
+
+  if (tree->nodes.size == tree->nodes.capacity) {
+    tree->nodes.capacity = tree->nodes.capacity == 0 ? 64 : tree->nodes.capacity * 2;
+    tree->nodes.values = realloc(tree->nodes.values, tree->nodes.capacity * sizeof(yp_node_t *));
+  }
+
+  tree->nodes.values[tree->nodes.size] = node;
+  return SIZET2NUM(tree->nodes.size++);
+}
+
+// Return the fields of the node at the given position in the table of this
+// tree. The type and start offset are there to match the interface of the lazy
+// loader for serialized trees.
+static VALUE
+lazy_tree_load_fields(VALUE self, VALUE type, VALUE position, VALUE start_offset) {
+  lazy_tree_t *tree;
+  TypedData_Get_Struct(self, lazy_tree_t, &lazy_tree_type, tree);
+
+  long index = NUM2LONG(position);
+  if (index < 0 || (size_t) index >= tree->nodes.size) rb_raise(rb_eArgError, "invalid node position: %ld", index);
+
+  yp_node_t *node = tree->nodes.values[index];
+  if (node->type != (yp_node_type_t) NUM2INT(type)) rb_raise(rb_eArgError, "node type mismatch");
+
+  return yp_node_lazy_fields(&tree->parser, node, self);
+}
+
+// Parse the given string like parse, except that the nodes in the tree are
+// only built as they're accessed.
+static VALUE
+parse_lazy(VALUE self, VALUE string) {
+  string = rb_str_new_frozen(string);
+
+  source_t source;
+  source_string_load(&source, string);
+  return parse_lazy_source(&source, string);
+}
+
+// Parse the given file like parse_file, except that the nodes in the tree are
+// only built as they're accessed. The file stays mapped until the tree is
+// garbage collected.
+static VALUE
+parse_file_lazy(VALUE self, VALUE filepath) {
+  source_t source;
+  if (source_file_load(&source, filepath) != 0) return Qnil;
+
+  return parse_lazy_source(&source, Qnil);
+}
+
+// A batch parses or dumps a list of files on a pool of native threads. Each
+// worker claims the next file in the list, maps it, and parses (and for dumps,
+// serializes) it without touching any Ruby objects. Meanwhile the calling
+// thread waits for the results in order and converts each one into Ruby
+// objects as it's ready. Workers stay at most a fixed window of files ahead of
+// the calling thread, which bounds how many results are held in memory.
+typedef struct {
+  char *filepath;
+  bool loaded;
+  bool done;
+  source_t source;
+  yp_parser_t parser;
+  yp_node_t *node;
+  yp_buffer_t buffer;
+} batch_job_t;
+
+typedef struct {
+  batch_job_t *jobs;
+  size_t size;
+  bool dump;
+
+  pthread_t *threads;
+  size_t threads_size;
+
+  pthread_mutex_t lock;
+  pthread_cond_t job_done;     // signaled when a job finishes (or on interrupt)
+  pthread_cond_t job_consumed; // signaled when the calling thread takes a result
+
+  size_t next;      // the index of the next job to claim
+  size_t consumed;  // the number of jobs whose results have been taken
+  size_t window;    // how far ahead of consumed the workers can claim jobs
+  bool cancelled;   // set when the calling thread stops early
+  bool interrupted; // set to wake the calling thread for Ruby interrupts
+} batch_t;
+
+// Run a single job. This happens on a worker thread without the GVL.
+static void
+batch_job_run(batch_t *batch, batch_job_t *job) {
+  if (source_file_open(&job->source, job->filepath) != 0) return;
+  job->loaded = true;
+
+  yp_parser_init(&job->parser, job->source.source, job->source.size);
+  job->node = yp_parse(&job->parser);
+
+  if (batch->dump) {
+    yp_buffer_init(&job->buffer);
+    yp_serialize(&job->parser, job->node, &job->buffer);
+
+    yp_node_destroy(&job->parser, job->node);
+    yp_parser_free(&job->parser);
+    source_file_unload(&job->source);
+    job->node = NULL;
+  }
+}
+
+// Free whatever a job still holds once its result has been taken (or if it's
+// never going to be).
+static void
+batch_job_free(batch_t *batch, batch_job_t *job) {
+  if (job->loaded) {
+    if (batch->dump) {
+      yp_buffer_free(&job->buffer);
+    } else {
+      yp_node_destroy(&job->parser, job->node);
+      yp_parser_free(&job->parser);
+      source_file_unload(&job->source);
+    }
+  }
+
+  free(job->filepath);
+}
+
+static void *
+batch_worker(void *data) {
+  batch_t *batch = (batch_t *) data;
+  pthread_mutex_lock(&batch->lock);
+
+  while (true) {
+    while (!batch->cancelled && batch->next < batch->size && batch->next >= batch->consumed + batch->window) {
+      pthread_cond_wait(&batch->job_consumed, &batch->lock);
+    }
+
+    if (batch->cancelled || batch->next >= batch->size) break;
+    batch_job_t *job = &batch->jobs[batch->next++];
+
+    pthread_mutex_unlock(&batch->lock);
+    batch_job_run(batch, job);
+    pthread_mutex_lock(&batch->lock);
+
+    job->done = true;
+    pthread_cond_broadcast(&batch->job_done);
+  }
+
+  pthread_mutex_unlock(&batch->lock);
+  return NULL;
+}
+
+// Wait for the job that the calling thread needs next. This is called without
+// the GVL, and returns early if batch_interrupt is called.
+static void *
+batch_wait(void *data) {
+  batch_t *batch = (batch_t *) data;
+  pthread_mutex_lock(&batch->lock);
+
+  while (!batch->jobs[batch->consumed].done && !batch->interrupted) {
+    pthread_cond_wait(&batch->job_done, &batch->lock);
+  }
+
+  batch->interrupted = false;
+  pthread_mutex_unlock(&batch->lock);
+  return NULL;
+}
+
+static void
+batch_interrupt(void *data) {
+  batch_t *batch = (batch_t *) data;
+  pthread_mutex_lock(&batch->lock);
+  batch->interrupted = true;
+  pthread_cond_broadcast(&batch->job_done);
+  pthread_mutex_unlock(&batch->lock);
+}
+
+// Take the results of every job in order, converting each into Ruby objects.
+static VALUE
+batch_collect(VALUE data) {
+  batch_t *batch = (batch_t *) data;
+  VALUE results = rb_ary_new_capa((long) batch->size);
+
+  while (batch->consumed < batch->size) {
+    batch_job_t *job = &batch->jobs[batch->consumed];
+
+    while (true) {
+      rb_thread_call_without_gvl(batch_wait, batch, batch_interrupt, batch);
+
+      pthread_mutex_lock(&batch->lock);
+      bool done = job->done;
+      pthread_mutex_unlock(&batch->lock);
+
+      if (done) break;
+      rb_thread_check_ints();
+    }
+
+    VALUE result = Qnil;
+    if (job->loaded) {
+      if (batch->dump) {
+        // Unlike dump_source, the workers can't serialize into a String,
+        // since they aren't Ruby threads and so can't take the GVL to grow
+        // one. The buffer can't be handed to a String either, since a String
+        // can only point at memory it doesn't own if it's frozen (see
+        // map_file), and these are the same as what dump_file returns. So it's
+        // copied, which takes about 1% of the time that parsing and
+        // serializing it did, while the workers carry on with other files.
+        result = rb_str_new(job->buffer.value, job->buffer.length);
+      } else {
+        result = parse_result_new(&job->parser, yp_node_new(&job->parser, job->node));
+      }
+    }
+
+    rb_ary_push(results, result);
+    batch_job_free(batch, job);
+
+    pthread_mutex_lock(&batch->lock);
+    batch->consumed++;
+    pthread_cond_broadcast(&batch->job_consumed);
+    pthread_mutex_unlock(&batch->lock);
+  }
+
+  return results;
+}
+
+static void *
+batch_join(void *data) {
+  batch_t *batch = (batch_t *) data;
+
+  for (size_t index = 0; index < batch->threads_size; index++) {
+    pthread_join(batch->threads[index], NULL);
+  }
+
+  return NULL;
+}
+
+// Stop the workers and free everything that the batch holds, whether or not
+// all of the results were taken.
+static VALUE
+batch_free(VALUE data) {
+  batch_t *batch = (batch_t *) data;
+
+  pthread_mutex_lock(&batch->lock);
+  batch->cancelled = true;
+  pthread_cond_broadcast(&batch->job_consumed);
+  pthread_mutex_unlock(&batch->lock);
+
+  rb_thread_call_without_gvl(batch_join, batch, NULL, NULL);
+
+  // Jobs that were claimed have finished now that the workers have been
+  // joined. Anything from consumed onward hasn't been taken yet.
+  for (size_t index = batch->consumed; index < batch->size; index++) {
+    batch_job_free(batch, &batch->jobs[index]);
+  }
+
+  pthread_cond_destroy(&batch->job_consumed);
+  pthread_cond_destroy(&batch->job_done);
+  pthread_mutex_destroy(&batch->lock);
+
+  free(batch->threads);
+  free(batch->jobs);
+  return Qnil;
+}
+
+// Parse or dump each of the given files on a pool of native threads and return
+// an array of the results in the same order. Files that can't be read result
+// in nil, just like parse_file and dump_file.
+static VALUE
+batch_run(int argc, VALUE *argv, bool dump) {
+  VALUE filepaths, options;
+  rb_scan_args(argc, argv, "1:", &filepaths, &options);
+  Check_Type(filepaths, T_ARRAY);
+
+  long threads = 0;
+  if (!NIL_P(options)) {
+    ID keywords[] = { rb_intern("threads") };
+    VALUE values[1];
+    rb_get_kwargs(options, keywords, 0, 1, values);
+    if (values[0] != Qundef) threads = NUM2LONG(values[0]);
+  }
+
+  if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads <= 0) threads = 1;
+
+  size_t size = (size_t) RARRAY_LEN(filepaths);
+  if ((size_t) threads > size) threads = (long) size;
+
+  // Convert each of the paths before allocating anything, since this can
+  // raise. The converted strings are kept so that paths that respond to
+  // to_str are only converted once.
+  VALUE converted = rb_ary_new_capa((long) size);
+  for (size_t index = 0; index < size; index++) {
+    VALUE filepath = rb_ary_entry(filepaths, (long) index);
+    StringValueCStr(filepath);
+    rb_ary_push(converted, filepath);
+  }
+
+  // Copy each of the paths up front, since the workers can't read Ruby
+  // strings.
+  batch_job_t *jobs = (batch_job_t *) calloc(size == 0 ? 1 : size, sizeof(batch_job_t));
+  for (size_t index = 0; index < size; index++) {
+    jobs[index].filepath = strdup(RSTRING_PTR(RARRAY_AREF(converted, (long) index)));
+  }
+  RB_GC_GUARD(converted);
+
+  batch_t batch = {
+    .jobs = jobs,
+    .size = size,
+    .dump = dump,
+    .threads = (pthread_t *) calloc(threads == 0 ? 1 : (size_t) threads, sizeof(pthread_t)),
+    .threads_size = 0,
+    .next = 0,
+    .consumed = 0,
+    .window = (size_t) threads * 4,
+    .cancelled = false,
+    .interrupted = false,
+  };
+
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.job_done, NULL);
+  pthread_cond_init(&batch.job_consumed, NULL);
+
+  for (long index = 0; index < threads; index++) {
+    if (pthread_create(&batch.threads[batch.threads_size], NULL, batch_worker, &batch) != 0) break;
+    batch.threads_size++;
+  }
+
+  // If no thread could be started at all, fall back to doing all of the work
+  // up front on the calling thread. This can't be interrupted, since the files
+  // are parsed by separate parsers one after another, but it only happens when
+  // the system is out of threads.
+  if (batch.threads_size == 0) {
+    batch.window = size;
+    rb_thread_call_without_gvl(batch_worker, &batch, NULL, NULL);
+  }
+
+  return rb_ensure(batch_collect, (VALUE) &batch, batch_free, (VALUE) &batch);
+}
+
+// Dump the ASTs corresponding to each of the given files to strings, using a
+// pool of native threads.
+static VALUE
+dump_files(int argc, VALUE *argv, VALUE self) {
+  return batch_run(argc, argv, true);
+}
+
+// Parse each of the given files into a ParseResult, using a pool of native
+// threads.
+static VALUE
+parse_files(int argc, VALUE *argv, VALUE self) {
+  return batch_run(argc, argv, false);
+}
+
 static VALUE
 named_captures(VALUE self, VALUE rb_source) {
   yp_string_list_t string_list;
@@ -239,21 +1063,49 @@ Init_yarp(void) {
   rb_cYARP = rb_define_module("YARP");
   rb_cYARPToken = rb_define_class_under(rb_cYARP, "Token", rb_cObject);
   rb_cYARPLocation = rb_define_class_under(rb_cYARP, "Location", rb_cObject);
+  rb_define_singleton_method(rb_cYARPLocation, "unpack", location_unpack, 1);
+
+  id_start_offset = rb_intern("@start_offset");
+  id_end_offset = rb_intern("@end_offset");
+  id_mapping = rb_intern("mapping");
 
   rb_cYARPComment = rb_define_class_under(rb_cYARP, "Comment", rb_cObject);
   rb_cYARPParseError = rb_define_class_under(rb_cYARP, "ParseError", rb_cObject);
   rb_cYARPParseResult = rb_define_class_under(rb_cYARP, "ParseResult", rb_cObject);
+  rb_cYARPNewlineList = rb_define_class_under(rb_cYARP, "NewlineList", rb_cObject);
+
+  rb_cYARPLazyTree = rb_define_class_under(rb_cYARP, "LazyTree", rb_cObject);
+  rb_undef_alloc_func(rb_cYARPLazyTree);
+  rb_define_private_method(rb_cYARPLazyTree, "load_fields", lazy_tree_load_fields, 3);
+
+  yp_node_init();
+
+  // The names of the token types, indexed by the type numbers that lex_packed
+  // returns.
+  VALUE token_types = rb_ary_new_capa(YP_TOKEN_MAXIMUM);
+  for (int type = 0; type < YP_TOKEN_MAXIMUM; type++) {
+    rb_ary_push(token_types, ID2SYM(rb_intern(yp_token_type_to_str(type))));
+  }
+  rb_define_const(rb_cYARP, "TOKEN_TYPES", rb_ary_freeze(token_types));
 
   rb_define_const(rb_cYARP, "VERSION", rb_sprintf("%d.%d.%d", YP_VERSION_MAJOR, YP_VERSION_MINOR, YP_VERSION_PATCH));
 
-  rb_define_singleton_method(rb_cYARP, "dump", dump, 1);
-  rb_define_singleton_method(rb_cYARP, "dump_file", dump_file, 1);
+  rb_define_singleton_method(rb_cYARP, "dump", dump, -1);
+  rb_define_singleton_method(rb_cYARP, "dump_file", dump_file, -1);
+  rb_define_singleton_method(rb_cYARP, "dump_files", dump_files, -1);
+  rb_define_singleton_method(rb_cYARP, "map_file", map_file, 1);
 
   rb_define_singleton_method(rb_cYARP, "lex", lex, 1);
   rb_define_singleton_method(rb_cYARP, "lex_file", lex_file, 1);
+  rb_define_singleton_method(rb_cYARP, "lex_packed", lex_packed, 1);
+  rb_define_singleton_method(rb_cYARP, "lex_file_packed", lex_file_packed, 1);
+  rb_define_singleton_method(rb_cYARP, "lex_packed_with_newlines", lex_packed_with_newlines, 1);
 
   rb_define_singleton_method(rb_cYARP, "parse", parse, 1);
   rb_define_singleton_method(rb_cYARP, "parse_file", parse_file, 1);
+  rb_define_singleton_method(rb_cYARP, "parse_files", parse_files, -1);
+  rb_define_singleton_method(rb_cYARP, "parse_lazy", parse_lazy, 1);
+  rb_define_singleton_method(rb_cYARP, "parse_file_lazy", parse_file_lazy, 1);
 
   rb_define_singleton_method(rb_cYARP, "named_captures", named_captures, 1);
 }
@@ -2,14 +2,20 @@
 #define YARP_EXT_NODE_H
 
 #include <ruby.h>
+#include <ruby/thread.h>
 #include <yarp.h>
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define EXPECTED_YARP_VERSION "0.2.0"
+#define EXPECTED_YARP_VERSION "0.5.0"
+
+void
+yp_node_init(void);
 
 VALUE
 yp_token_new(yp_parser_t *parser, yp_token_t *token);
@@ -17,4 +23,13 @@ yp_token_new(yp_parser_t *parser, yp_token_t *token);
 VALUE
 yp_node_new(yp_parser_t *parser, yp_node_t *node);
 
+VALUE
+yp_node_lazy_new(yp_parser_t *parser, yp_node_t *node, VALUE owner);
+
+VALUE
+yp_node_lazy_fields(yp_parser_t *parser, yp_node_t *node, VALUE owner);
+
+VALUE
+yp_lazy_tree_position(VALUE owner, yp_node_t *node);
+
 #endif // YARP_EXT_NODE_H
@@ -0,0 +1,33 @@
+package org.yarp;
+
+import java.util.Arrays;
+
+// The byte offsets of the starts of the lines in a source, as they were written
+// into the header of a serialized tree. This turns the offsets held by nodes
+// and tokens into lines and columns without needing the source.
+public final class NewlineList {
+
+    public final int[] offsets;
+
+    public NewlineList(int[] offsets) {
+        this.offsets = offsets;
+    }
+
+    // Returns the line number (starting at 1) of the given byte offset.
+    public int line(int offset) {
+        return lineIndex(offset) + 1;
+    }
+
+    // Returns the column (in bytes, starting at 0) of the given byte offset.
+    public int column(int offset) {
+        return offset - offsets[lineIndex(offset)];
+    }
+
+    // Find the last line that starts at or before the given offset. The first
+    // line always starts at 0, so there is always one.
+    private int lineIndex(int offset) {
+        int index = Arrays.binarySearch(offsets, offset);
+        return index >= 0 ? index : -index - 2;
+    }
+
+}
@@ -17,6 +17,18 @@ module YARP
     def self.null
       new(0, 0)
     end
+
+    # Nodes and tokens built by the extension hold their location packed into a
+    # single integer, with the start offset in the high 32 bits and the end
+    # offset in the low 32 bits. The Location object is only built (by
+    # Location.unpack, which is defined in the extension) the first time that
+    # it's asked for.
+    module Packed
+      def location
+        location = @location
+        location.is_a?(Integer) ? (@location = Location.unpack(location)) : location
+      end
+    end
   end
 
   # This represents a comment that was encountered during parsing.
@@ -47,20 +59,67 @@ module YARP
     end
   end
 
+  # This represents the offsets of the starts of the lines in a source, which
+  # the parser records as it lexes. It's used to turn an offset into a line and
+  # column. Each lookup is a binary search, except that a lookup on the same
+  # line as the last one or the line after it is answered directly, so walking
+  # through the offsets of a source in order is amortized O(1) per lookup.
+  class NewlineList
+    attr_reader :offsets
+
+    def initialize(offsets)
+      @offsets = offsets
+      @last_line = 0
+    end
+
+    # Returns the line number (starting at 1) of the given byte offset.
+    def line(offset)
+      line_index(offset) + 1
+    end
+
+    # Returns the column (in bytes, starting at 0) of the given byte offset.
+    def column(offset)
+      offset - offsets[line_index(offset)]
+    end
+
+    # Returns the line and column of the given byte offset as a pair.
+    def line_column(offset)
+      index = line_index(offset)
+      [index + 1, offset - offsets[index]]
+    end
+
+    private
+
+    def line_index(offset)
+      index = @last_line
+
+      if offsets[index] <= offset
+        next_offset = offsets[index + 1]
+        return index if next_offset.nil? || offset < next_offset
+
+        following_offset = offsets[index + 2]
+        return @last_line = index + 1 if following_offset.nil? || offset < following_offset
+      end
+
+      @last_line = (offsets.bsearch_index { |start| start > offset } || offsets.length) - 1
+    end
+  end
+
   # This represents the result of a call to ::parse or ::parse_file. It contains
-  # the AST, any comments that were encounters, and any errors that were
-  # encountered.
+  # the AST, any comments that were encounters, any errors that were
+  # encountered, and the starts of the lines in the source.
   class ParseResult
-    attr_reader :node, :comments, :errors
+    attr_reader :node, :comments, :errors, :newlines
 
-    def initialize(node, comments, errors)
+    def initialize(node, comments, errors, newlines)
       @node = node
       @comments = comments
       @errors = errors
+      @newlines = newlines
     end
 
     def deconstruct_keys(keys)
-      { node: node, comments: comments, errors: errors }
+      { node: node, comments: comments, errors: errors, newlines: newlines }
     end
 
     def success?
@@ -74,7 +133,9 @@ module YARP
 
   # This represents a token from the Ruby source.
   class Token
-    attr_reader :type, :value, :location
+    include Location::Packed
+
+    attr_reader :type, :value
 
     def initialize(type, value, location)
       @type = type
@@ -105,6 +166,8 @@ module YARP
 
   # This represents a node in the tree.
   class Node
+    include Location::Packed
+
     def pretty_print(q)
       q.group do
         q.text("#{self.class.name.split("::").last}(")
@@ -158,25 +221,15 @@ module YARP
   # The only difference is that since we don't keep track of lexer state in the
   # same way, it's going to always return the NONE state.
   def self.lex_compat(source)
-    offsets = [0]
-    source.each_line { |line| offsets << offsets.last + line.bytesize }
-
     lexer_state = Ripper::Lexer::State.new(0)
     tokens = []
 
-    lex(source).each do |token|
-      line_number, line_offset =
-        offsets.each_with_index.detect do |(offset, line)|
-          break [line, offsets[line - 1]] if token.location.start_offset < offset
-        end
-
-      line_number ||= offsets.length + 1
-      line_offset ||= offsets.last
+    packed, newlines = lex_packed_with_newlines(source)
+    packed.unpack("L*").each_slice(3) do |type, start_offset, end_offset|
+      line_number, line_byte = newlines.line_column(start_offset)
+      event = RIPPER.fetch(TOKEN_TYPES[type])
 
-      line_byte = token.location.start_offset - line_offset
-      event = RIPPER.fetch(token.type)
-
-      value = token.value
+      value = source.byteslice(start_offset, end_offset - start_offset)
       normalized =
         case event
         when :on_comment, :on_tstring_content
@@ -207,6 +260,18 @@ module YARP
     Serialize.load(source, serialized)
   end
 
+  # Load the serialized AST like ::load, except that the children of each node
+  # are only read from the serialized string when they are first accessed.
+  def self.load_lazy(source, serialized)
+    Serialize.load_lazy(source, serialized)
+  end
+
+  # Load the NewlineList from the header of a string that was serialized with
+  # newlines: true, without needing the source. Returns nil if it wasn't.
+  def self.load_newlines(serialized)
+    Serialize.load_newlines(serialized)
+  end
+
   RIPPER = {
     AMPERSAND: :on_op,
     AMPERSAND_AMPERSAND: :on_op,
@@ -353,3 +418,4 @@ end
 require_relative "yarp/node"
 require_relative "yarp/serialize"
 require_relative "yarp/yarp"
+require_relative "yarp/cache"
@@ -0,0 +1,81 @@
+# frozen_string_literal: true
+
+require "digest"
+require "fileutils"
+
+module YARP
+  # A cache of serialized syntax trees on disk. Entries are keyed on a hash of
+  # the contents of the source and the version of YARP that serialized them, so
+  # a file that hasn't changed is never parsed twice, and bumping the version
+  # invalidates every entry. Entries are written to a temporary file and then
+  # renamed into place, so any number of processes can share one directory
+  # without ever reading a partially written entry, and an entry that has been
+  # mapped by a reader never changes underneath it.
+  class Cache
+    # Every serialized string starts with this header, which is used to check
+    # that an entry was written by this version of YARP.
+    HEADER = ["YARP", *VERSION.split(".").map(&:to_i)].pack("a4C3").freeze
+    private_constant :HEADER
+
+    attr_reader :directory
+
+    def initialize(directory)
+      @directory = directory
+    end
+
+    # Returns the same string as YARP.dump_file, reading it from the cache if
+    # the contents of the file have been serialized before.
+    def dump_file(filepath)
+      dump(File.binread(filepath))
+    end
+
+    # Returns the same string as YARP.dump, reading it from the cache if the
+    # source has been serialized before. Entries are mapped rather than read,
+    # so a cached string is frozen and only the parts of it that are used (say
+    # by a lazy load) are read from disk.
+    def dump(source)
+      path = path_for(source)
+
+      begin
+        serialized = YARP.map_file(path)
+        return serialized if serialized.start_with?(HEADER)
+      rescue SystemCallError
+        # A missing entry is the usual case, but anything else that keeps the
+        # entry from being read (say a permissions problem) is also treated as
+        # a miss.
+      end
+
+      serialized = YARP.dump(source)
+      write(path, serialized)
+      serialized
+    end
+
+    # Load the syntax tree for the given file, using the cache for the
+    # serialized form.
+    def load_file(filepath, lazy: false)
+      source = File.binread(filepath)
+      serialized = dump(source)
+      lazy ? YARP.load_lazy(source, serialized) : YARP.load(source, serialized)
+    end
+
+    # The path to the entry for the given source.
+    def path_for(source)
+      key = Digest::SHA256.hexdigest(source)
+      File.join(directory, VERSION, key[0, 2], key[2..])
+    end
+
+    private
+
+    def write(path, serialized)
+      FileUtils.mkdir_p(File.dirname(path))
+
+      temporary = "#{path}.#{Process.pid}.#{Thread.current.object_id}.tmp"
+      File.binwrite(temporary, serialized)
+      File.rename(temporary, path)
+    rescue SystemCallError
+      # The cache is only an optimization, so if it can't be written (say the
+      # directory is read-only) then the result is returned without it.
+      File.unlink(temporary) if temporary && File.exist?(temporary)
+    end
+  end
+end
@@ -3,7 +3,7 @@
 typedef uint32_t unicode_codepoint_t;
 
 #define UNICODE_ALPHA_CODEPOINTS_LENGTH 1444
-unicode_codepoint_t unicode_alpha_codepoints[UNICODE_ALPHA_CODEPOINTS_LENGTH] = {
+static const unicode_codepoint_t unicode_alpha_codepoints[UNICODE_ALPHA_CODEPOINTS_LENGTH] = {
   0x0041, 0x005a,
   0x0061, 0x007a,
   0x00aa, 0x00aa,
@@ -729,7 +729,7 @@ unicode_codepoint_t unicode_alpha_codepoints[UNICODE_ALPHA_CODEPOINTS_LENGTH] =
 };
 
 #define UNICODE_ALNUM_CODEPOINTS_LENGTH 1520
-unicode_codepoint_t unicode_alnum_codepoints[UNICODE_ALNUM_CODEPOINTS_LENGTH] = {
+static const unicode_codepoint_t unicode_alnum_codepoints[UNICODE_ALNUM_CODEPOINTS_LENGTH] = {
   0x0030, 0x0039,
   0x0041, 0x005a,
   0x0061, 0x007a,
@@ -1492,17 +1492,34 @@ unicode_codepoint_t unicode_alnum_codepoints[UNICODE_ALNUM_CODEPOINTS_LENGTH] =
   0x30000, 0x3134a,
 };
 
+// The codepoint tables are sorted lists of non-overlapping inclusive ranges, so
+// we can binary search them for the range that could contain the codepoint.
 static bool
-unicode_codepoint_match(unicode_codepoint_t codepoint, unicode_codepoint_t *codepoints, size_t size) {
-  for (size_t index = 0; index < size; index += 2) {
-    if (codepoint >= codepoints[index] && codepoint <= codepoints[index + 1])
+unicode_codepoint_match(unicode_codepoint_t codepoint, const unicode_codepoint_t *codepoints, size_t size) {
+  size_t start = 0;
+  size_t end = size / 2;
+
+  while (start < end) {
+    size_t middle = start + (end - start) / 2;
+
+    if (codepoint < codepoints[middle * 2]) {
+      end = middle;
+    } else if (codepoint > codepoints[middle * 2 + 1]) {
+      start = middle + 1;
+    } else {
       return true;
+    }
   }
+
   return false;
 }
 
 static unicode_codepoint_t
-utf_8_codepoint(const char *c, size_t *width) {
+utf_8_codepoint(const char *source, size_t *width) {
+  // We need to read the bytes as unsigned, otherwise the shifts below would
+  // sign-extend any byte with the high bit set.
+  const unsigned char *c = (const unsigned char *) source;
+
   if ((c[0] >> 7) == 0b0) {
     // 0xxxxxxx
     *width = 1;
@@ -1516,12 +1533,12 @@ utf_8_codepoint(const char *c, size_t *width) {
   if (((c[0] >> 4) == 0b1110) && ((c[1] >> 6) == 0b10) && ((c[2] >> 6) == 0b10)) {
     // 1110xxxx 10xxxxxx 10xxxxxx
     *width = 3;
-    return ((c[0] & 0b1111) << 12) | ((c[1] & 0b111111) << 6) | (c[2] & 0b11111);
+    return ((c[0] & 0b1111) << 12) | ((c[1] & 0b111111) << 6) | (c[2] & 0b111111);
   }
   if (((c[0] >> 3) == 0b11110) && ((c[1] >> 6) == 0b10) && ((c[2] >> 6) == 0b10) && ((c[3] >> 6) == 0b10)) {
     // 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx
     *width = 4;
-    return ((c[0] & 0b111) << 18) | ((c[1] & 0b111111) << 12) | ((c[2] & 0b11111) << 6) | (c[3] & 0b11111);
+    return ((c[0] & 0b111) << 18) | ((c[1] & 0b111111) << 12) | ((c[2] & 0b111111) << 6) | (c[3] & 0b111111);
   }
   return 0;
 }
@@ -3,7 +3,9 @@
 
 #include <stdbool.h>
 #include "enc/yp_encoding.h"
+#include "util/yp_arena.h"
 #include "util/yp_list.h"
+#include "util/yp_newline_list.h"
 #include "ast.h"
 
 // When lexing Ruby source, the lexer has a small amount of state to tell which
@@ -90,6 +92,24 @@ typedef struct yp_context_node {
   struct yp_context_node *prev;
 } yp_context_node_t;
 
+// This is a slot in the hash set of local variable names kept for each scope.
+typedef struct {
+  uint32_t hash;  // the hash of the bytes of the name
+  uint32_t index; // one more than the index of the name in the scope's list of locals, or 0 if empty
+} yp_scope_slot_t;
+
+// This is a node in a linked list of local variable scopes. The names of the
+// locals are kept in order on the Scope node so that they can be serialized.
+// Alongside that list we keep an open-addressing hash set keyed on the bytes of
+// each name so that identifiers can be resolved without scanning the list.
+typedef struct yp_scope_node {
+  yp_node_t *node;             // the Scope node that owns the list of locals
+  yp_scope_slot_t *slots;      // the slots of the hash set
+  uint32_t capacity;           // the number of slots, always zero or a power of two
+  uint32_t size;               // the number of distinct names in the set
+  struct yp_scope_node *prev;
+} yp_scope_node_t;
+
 // This is the type of a comment that we've found while parsing.
 typedef enum {
   YP_COMMENT_INLINE,
@@ -118,6 +138,35 @@ typedef struct {
 // our encoding and use it to parse identifiers.
 typedef yp_encoding_t *(*yp_encoding_decode_callback_t)(const char *name, size_t width);
 
+// This is the state of the parser at the top of the loop that parses a list of
+// statements, or just after that loop has finished. These are recorded for the
+// bodies of the program, classes, modules, singleton classes, and methods so
+// that yp_reparse can resume parsing in the middle of a previous tree and can
+// tell when it has caught back up with it.
+typedef struct {
+  const yp_node_t *statements;   // the Statements node being parsed
+  uint32_t index;                // the number of statements parsed so far
+  bool closing;                  // whether the loop over the statements has finished
+  bool recovering;               // whether the parser was recovering from a syntax error
+  yp_token_type_t previous_type; // the type of the previous token
+  uint32_t previous_start;       // the offset of the start of the previous token
+  uint32_t previous_end;         // the offset of the end of the previous token
+  yp_token_type_t current_type;  // the type of the current token
+  uint32_t current_start;        // the offset of the start of the current token
+  uint32_t current_end;          // the offset of the end of the current token
+  size_t errors;                 // the number of errors that had been found
+  yp_encoding_t encoding;        // the encoding that was in use
+} yp_checkpoint_t;
+
+// This describes an edit made to a source that was already parsed. The bytes
+// from start to old_end in the previous source were replaced by the bytes from
+// start to new_end in the new source.
+typedef struct {
+  uint32_t start;
+  uint32_t old_end;
+  uint32_t new_end;
+} yp_edit_t;
+
 // This struct represents the overall parser. It contains a reference to the
 // source file, as well as pointers that indicate where in the source it's
 // currently parsing. It also contains the most recent and current token that
@@ -136,10 +185,29 @@ struct yp_parser {
 
   yp_list_t comment_list;             // the list of comments that have been found while parsing
   yp_list_t error_list;               // the list of errors that have been found while parsing
-  yp_node_t *current_scope;           // the current local scope
+  yp_newline_list_t newline_list;     // the starts of the lines that have been lexed so far
+  yp_scope_node_t *current_scope;     // the current local scope
+  yp_arena_t arena;                   // the arena that the nodes in the tree are allocated from
 
   yp_context_node_t *current_context; // the current parsing context
   bool recovering; // whether or not we're currently recovering from a syntax error
+  bool reparseable; // whether or not checkpoints are recorded so that the tree can be reparsed
+  bool cancelled; // set by yp_parser_cancel, possibly from another thread, to stop at the next token
+
+  // The states of the parser between the statements of the bodies that can be
+  // reparsed, in the order that they were reached. These are only recorded if
+  // the parser is reparseable.
+  struct {
+    yp_checkpoint_t *values;
+    size_t size;
+    size_t capacity;
+  } checkpoints;
+
+  // Reparsing moves the memory for the previous tree into the new parser's
+  // arena, including the nodes that the edit replaced. Once the arena holds
+  // more than this many bytes, yp_reparse parses from scratch instead so that
+  // the memory doesn't grow with every edit.
+  size_t arena_limit;
 
   // The encoding functions for the current file is attached to the parser as
   // it's parsing so that it can change with a magic comment.
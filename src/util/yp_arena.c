@@ -0,0 +1,97 @@
+#include "yp_arena.h"
+
+// Every allocation is rounded up to this alignment so that pointers and
+// integers within the allocated structs are naturally aligned.
+#define YP_ARENA_ALIGNMENT sizeof(void *)
+
+// Allocate a new block with the given capacity and link it into the arena.
+static yp_arena_block_t *
+yp_arena_block_alloc(yp_arena_block_t *prev, size_t capacity) {
+  yp_arena_block_t *block = (yp_arena_block_t *) malloc(sizeof(yp_arena_block_t) + capacity);
+  block->prev = prev;
+  block->length = 0;
+  block->capacity = capacity;
+  return block;
+}
+
+// Initialize a yp_arena_t with its default values.
+void
+yp_arena_init(yp_arena_t *arena) {
+  arena->current = NULL;
+  arena->size = 0;
+}
+
+// Allocate size bytes of memory from the arena. The returned pointer is aligned
+// such that it can hold any of the structs in the syntax tree.
+void *
+yp_arena_alloc(yp_arena_t *arena, size_t size) {
+  size = (size + YP_ARENA_ALIGNMENT - 1) & ~(YP_ARENA_ALIGNMENT - 1);
+  yp_arena_block_t *block = arena->current;
+
+  if (block == NULL || block->length + size > block->capacity) {
+    if (size > YP_ARENA_BLOCK_SIZE) {
+      // If the allocation is larger than a regular block, then we'll give it
+      // its own block. We link it in behind the current block so that the
+      // remaining space in the current block can still be used.
+      yp_arena_block_t *large = yp_arena_block_alloc(block == NULL ? NULL : block->prev, size);
+      large->length = size;
+      arena->size += size;
+
+      if (block == NULL) {
+        arena->current = large;
+      } else {
+        block->prev = large;
+      }
+
+      return large->value;
+    }
+
+    block = yp_arena_block_alloc(block, YP_ARENA_BLOCK_SIZE);
+    arena->current = block;
+    arena->size += YP_ARENA_BLOCK_SIZE;
+  }
+
+  void *value = block->value + block->length;
+  block->length += size;
+  return value;
+}
+
+// Take ownership of all of the memory allocated by the other arena, leaving it
+// empty. The other arena's blocks are linked in behind the current block so
+// that the remaining space in the current block can still be used.
+void
+yp_arena_adopt(yp_arena_t *arena, yp_arena_t *other) {
+  yp_arena_block_t *blocks = other->current;
+  if (blocks == NULL) return;
+
+  other->current = NULL;
+  arena->size += other->size;
+  other->size = 0;
+
+  if (arena->current == NULL) {
+    arena->current = blocks;
+    return;
+  }
+
+  yp_arena_block_t *last = blocks;
+  while (last->prev != NULL) last = last->prev;
+
+  last->prev = arena->current->prev;
+  arena->current->prev = blocks;
+}
+
+// Free all of the memory associated with the arena.
+void
+yp_arena_free(yp_arena_t *arena) {
+  yp_arena_block_t *block = arena->current;
+  yp_arena_block_t *prev;
+
+  while (block != NULL) {
+    prev = block->prev;
+    free(block);
+    block = prev;
+  }
+
+  arena->current = NULL;
+  arena->size = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef YARP_ARENA_H
+#define YARP_ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// The size of each of the blocks that the arena allocates from the system. Any
+// allocation that is larger than this will get its own block.
+#define YP_ARENA_BLOCK_SIZE 16384
+
+// This represents a single block of memory that the arena is bumping through.
+// Blocks are linked together so that they can all be freed at once.
+typedef struct yp_arena_block {
+  struct yp_arena_block *prev;
+  size_t length;
+  size_t capacity;
+  char value[];
+} yp_arena_block_t;
+
+// A yp_arena_t is a bump allocator. Allocations are served by advancing a
+// pointer through a large block of memory, and they are never freed
+// individually. Instead the whole arena is released at once. It is used to
+// allocate the nodes in the syntax tree so that building and tearing down a
+// tree doesn't involve a call to malloc and free for every node.
+typedef struct {
+  yp_arena_block_t *current;
+  size_t size; // the number of bytes held by all of the blocks
+} yp_arena_t;
+
+// Initialize a yp_arena_t with its default values.
+void
+yp_arena_init(yp_arena_t *arena);
+
+// Allocate size bytes of memory from the arena. The returned pointer is aligned
+// such that it can hold any of the structs in the syntax tree.
+void *
+yp_arena_alloc(yp_arena_t *arena, size_t size);
+
+// Take ownership of all of the memory allocated by the other arena, leaving it
+// empty. Everything that was allocated from either arena is then freed when
+// this arena is freed.
+void
+yp_arena_adopt(yp_arena_t *arena, yp_arena_t *other);
+
+// Free all of the memory associated with the arena.
+void
+yp_arena_free(yp_arena_t *arena);
+
+#endif
@@ -14,14 +14,25 @@ yp_buffer_init(yp_buffer_t *buffer) {
   buffer->value = (char *) malloc(YP_BUFFER_INITIAL_SIZE);
   buffer->length = 0;
   buffer->capacity = YP_BUFFER_INITIAL_SIZE;
+  buffer->grow = NULL;
+  buffer->data = NULL;
+  buffer->failed = false;
 }
 
 // Append a generic pointer to memory to the buffer.
 static inline void
 yp_buffer_append(yp_buffer_t *buffer, const void *source, size_t length) {
   if (buffer->length + length > buffer->capacity) {
-    buffer->capacity = buffer->capacity * 2;
-    buffer->value = realloc(buffer->value, buffer->capacity);
+    size_t capacity = buffer->capacity == 0 ? YP_BUFFER_INITIAL_SIZE : buffer->capacity;
+    while (buffer->length + length > capacity) capacity *= 2;
+
+    if (buffer->grow == NULL) {
+      buffer->value = realloc(buffer->value, capacity);
+      buffer->capacity = capacity;
+    } else if (!buffer->grow(buffer, capacity)) {
+      buffer->failed = true;
+      return;
+    }
   }
   memcpy(buffer->value + buffer->length, source, length);
   buffer->length += length;
@@ -62,6 +73,23 @@ yp_buffer_append_u64(yp_buffer_t *buffer, uint64_t value) {
   yp_buffer_append(buffer, source, sizeof(uint64_t));
 }
 
+// Append an unsigned integer to the buffer as a variable-length quantity (7
+// bits per byte, least significant group first, with the high bit set on every
+// byte except the last).
+void
+yp_buffer_append_varint(yp_buffer_t *buffer, uint64_t value) {
+  uint8_t bytes[10];
+  size_t length = 0;
+
+  while (value >= 0x80) {
+    bytes[length++] = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+
+  bytes[length++] = (uint8_t) value;
+  yp_buffer_append(buffer, bytes, length);
+}
+
 // Free the memory associated with the buffer.
 void
 yp_buffer_free(yp_buffer_t *buffer) {
@@ -1,6 +1,7 @@
 #ifndef YARP_BUFFER_H
 #define YARP_BUFFER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,10 +9,22 @@
 // A yp_buffer_t is a simple memory buffer that stores data in a contiguous
 // block of memory. It is used to store the serialized representation of a
 // YARP tree.
-typedef struct {
+typedef struct yp_buffer {
   char *value;
   size_t length;
   size_t capacity;
+
+  // If this is set, it's called to grow the buffer to at least the given
+  // capacity instead of calling realloc, so that the memory can come from
+  // another allocator. It has to update value and capacity, and data is left
+  // for it to use. Whoever sets it also owns the memory, so yp_buffer_free
+  // shouldn't be called on the buffer. If it can't grow the buffer, it leaves
+  // it as it was and returns false. The append that needed the space is then
+  // dropped and failed is set, so whatever is writing to the buffer should
+  // check failed and stop.
+  bool (*grow)(struct yp_buffer *buffer, size_t capacity);
+  void *data;
+  bool failed;
 } yp_buffer_t;
 
 // Allocate a new yp_buffer_t.
@@ -42,6 +55,12 @@ yp_buffer_append_u32(yp_buffer_t *buffer, uint32_t value);
 void
 yp_buffer_append_u64(yp_buffer_t *buffer, uint64_t value);
 
+// Append an unsigned integer to the buffer as a variable-length quantity (7
+// bits per byte, least significant group first, with the high bit set on every
+// byte except the last).
+void
+yp_buffer_append_varint(yp_buffer_t *buffer, uint64_t value);
+
 // Free the memory associated with the buffer.
 __attribute__ ((__visibility__("default"))) extern void
 yp_buffer_free(yp_buffer_t *buffer);
@@ -0,0 +1,83 @@
+#include "yp_constant_pool.h"
+
+// Hash the bytes of a constant. This is FNV-1a, which is quick for the short
+// names that make up most constants.
+uint32_t
+yp_constant_pool_hash(const char *start, size_t length) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t index = 0; index < length; index++) {
+    hash ^= (uint8_t) start[index];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+// Double the capacity of the hash set (or allocate it if it's empty) and
+// reinsert all of the existing constants.
+static void
+yp_constant_pool_resize(yp_constant_pool_t *pool) {
+  uint32_t capacity = pool->slots_capacity == 0 ? 64 : pool->slots_capacity * 2;
+  uint32_t *slots = (uint32_t *) calloc(capacity, sizeof(uint32_t));
+
+  for (uint32_t index = 0; index < pool->slots_capacity; index++) {
+    uint32_t id = pool->slots[index];
+    if (id == 0) continue;
+
+    uint32_t target = pool->constants[id - 1].hash & (capacity - 1);
+    while (slots[target] != 0) target = (target + 1) & (capacity - 1);
+    slots[target] = id;
+  }
+
+  free(pool->slots);
+  pool->slots = slots;
+  pool->slots_capacity = capacity;
+}
+
+// Initialize a yp_constant_pool_t with its default values.
+void
+yp_constant_pool_init(yp_constant_pool_t *pool) {
+  *pool = (yp_constant_pool_t) { .constants = NULL, .size = 0, .capacity = 0, .slots = NULL, .slots_capacity = 0 };
+}
+
+// Return the id of the given string, inserting it into the pool if it's not
+// already there.
+uint32_t
+yp_constant_pool_insert(yp_constant_pool_t *pool, const char *start, size_t length) {
+  // Keep the hash set at most half full so that probe sequences stay short.
+  if ((pool->size + 1) * 2 > pool->slots_capacity) yp_constant_pool_resize(pool);
+
+  uint32_t hash = yp_constant_pool_hash(start, length);
+  uint32_t mask = pool->slots_capacity - 1;
+  uint32_t index = hash & mask;
+
+  while (pool->slots[index] != 0) {
+    uint32_t id = pool->slots[index] - 1;
+    yp_constant_t *constant = &pool->constants[id];
+
+    if (constant->hash == hash && constant->length == length && memcmp(constant->start, start, length) == 0) {
+      return id;
+    }
+
+    index = (index + 1) & mask;
+  }
+
+  if (pool->size == pool->capacity) {
+    pool->capacity = pool->capacity == 0 ? 64 : pool->capacity * 2;
+    pool->constants = (yp_constant_t *) realloc(pool->constants, pool->capacity * sizeof(yp_constant_t));
+  }
+
+  uint32_t id = (uint32_t) pool->size++;
+  pool->constants[id] = (yp_constant_t) { .start = start, .length = length, .hash = hash };
+  pool->slots[index] = id + 1;
+
+  return id;
+}
+
+// Free the memory associated with the pool.
+void
+yp_constant_pool_free(yp_constant_pool_t *pool) {
+  free(pool->constants);
+  free(pool->slots);
+}
@@ -0,0 +1,47 @@
+#ifndef YARP_CONSTANT_POOL_H
+#define YARP_CONSTANT_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A constant in the pool is a run of bytes that is held by reference. The pool
+// doesn't copy them, so they must outlive it.
+typedef struct {
+  const char *start;
+  size_t length;
+  uint32_t hash;
+} yp_constant_t;
+
+// A yp_constant_pool_t interns byte strings. Each distinct string is given an
+// id, which is its index in the order that strings were first inserted. Lookup
+// goes through an open-addressing hash set keyed on the bytes of each string.
+typedef struct {
+  yp_constant_t *constants;
+  size_t size;
+  size_t capacity;
+
+  uint32_t *slots;       // one more than the id of the constant in each slot, or 0 if empty
+  uint32_t slots_capacity;
+} yp_constant_pool_t;
+
+// Hash the bytes of a constant. This is FNV-1a, which is quick for the short
+// names that make up most constants. The parser's sets of locals use it too.
+uint32_t
+yp_constant_pool_hash(const char *start, size_t length);
+
+// Initialize a yp_constant_pool_t with its default values.
+void
+yp_constant_pool_init(yp_constant_pool_t *pool);
+
+// Return the id of the given string, inserting it into the pool if it's not
+// already there.
+uint32_t
+yp_constant_pool_insert(yp_constant_pool_t *pool, const char *start, size_t length);
+
+// Free the memory associated with the pool.
+void
+yp_constant_pool_free(yp_constant_pool_t *pool);
+
+#endif
@@ -9,7 +9,7 @@ yp_list_alloc(void) {
 // Initializes a new list.
 void
 yp_list_init(yp_list_t *list) {
-  *list = (yp_list_t) { .head = NULL, .tail = NULL };
+  *list = (yp_list_t) { .head = NULL, .tail = NULL, .size = 0 };
 }
 
 // Append a node to the given list.
@@ -21,6 +21,24 @@ yp_list_append(yp_list_t *list, yp_list_node_t *node) {
     list->tail->next = node;
   }
   list->tail = node;
+  list->size++;
+}
+
+// Move all of the nodes in the other list onto the end of the given list,
+// leaving the other list empty.
+void
+yp_list_concat(yp_list_t *list, yp_list_t *other) {
+  if (other->head == NULL) return;
+
+  if (list->head == NULL) {
+    list->head = other->head;
+  } else {
+    list->tail->next = other->head;
+  }
+
+  list->tail = other->tail;
+  list->size += other->size;
+  yp_list_init(other);
 }
 
 // Deallocate the internal state of the given list.
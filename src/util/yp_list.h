@@ -13,10 +13,12 @@ typedef struct yp_list_node {
 } yp_list_node_t;
 
 // This represents the overall linked list. It keeps a pointer to the head and
-// tail so that iteration is easy and pushing new nodes is easy.
+// tail so that iteration is easy and pushing new nodes is easy, along with the
+// number of nodes in the list.
 typedef struct {
   yp_list_node_t *head;
   yp_list_node_t *tail;
+  size_t size;
 } yp_list_t;
 
 // Allocate a new list.
@@ -31,6 +33,11 @@ yp_list_init(yp_list_t *list);
 void
 yp_list_append(yp_list_t *list, yp_list_node_t *node);
 
+// Move all of the nodes in the other list onto the end of the given list,
+// leaving the other list empty.
+void
+yp_list_concat(yp_list_t *list, yp_list_t *other);
+
 // Deallocate the internal state of the given list.
 void
 yp_list_free(yp_list_t *list);
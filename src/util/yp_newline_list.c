@@ -0,0 +1,65 @@
+#include "yp_newline_list.h"
+
+// Initialize a newline list with the start of the first line.
+void
+yp_newline_list_init(yp_newline_list_t *list) {
+  *list = (yp_newline_list_t) { .offsets = NULL, .size = 0, .capacity = 0, .scanned = 0 };
+  yp_newline_list_append(list, 0);
+}
+
+// Append the start of a line to the list.
+void
+yp_newline_list_append(yp_newline_list_t *list, uint32_t offset) {
+  if (list->size == list->capacity) {
+    list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+    list->offsets = realloc(list->offsets, list->capacity * sizeof(uint32_t));
+  }
+
+  list->offsets[list->size++] = offset;
+}
+
+// Record the start of every line that follows a newline in the given source
+// before the given offset that hasn't already been scanned.
+void
+yp_newline_list_scan(yp_newline_list_t *list, const char *source, size_t until) {
+  if (until <= list->scanned) return;
+
+  const char *cursor = source + list->scanned;
+  const char *end = source + until;
+
+  while ((cursor = memchr(cursor, '\n', (size_t) (end - cursor))) != NULL) {
+    cursor++;
+    yp_newline_list_append(list, (uint32_t) (cursor - source));
+  }
+
+  list->scanned = until;
+}
+
+// Returns the line and column of the given offset, using a binary search over
+// the starts of the lines. Offsets past the end of the source are on the last
+// line.
+yp_line_column_t
+yp_newline_list_line_column(const yp_newline_list_t *list, uint32_t offset) {
+  size_t left = 0;
+  size_t right = list->size;
+
+  // Find the last line that starts at or before the offset. The first line
+  // starts at 0, so there always is one.
+  while (right - left > 1) {
+    size_t middle = left + (right - left) / 2;
+
+    if (list->offsets[middle] <= offset) {
+      left = middle;
+    } else {
+      right = middle;
+    }
+  }
+
+  return (yp_line_column_t) { .line = left + 1, .column = offset - list->offsets[left] };
+}
+
+// Free the memory associated with the newline list.
+void
+yp_newline_list_free(yp_newline_list_t *list) {
+  free(list->offsets);
+}
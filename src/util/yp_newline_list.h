@@ -0,0 +1,51 @@
+#ifndef YARP_NEWLINE_LIST_H
+#define YARP_NEWLINE_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The offsets of the starts of each line in a source, which the parser records
+// as it lexes. The first line always starts at offset 0, and every other line
+// starts one byte after a newline. The bytes up to scanned have already been
+// searched for newlines, so each byte is only ever looked at once even though
+// the lexer can move past the same part of the source more than once.
+typedef struct {
+  uint32_t *offsets;
+  size_t size;
+  size_t capacity;
+  size_t scanned;
+} yp_newline_list_t;
+
+// A line and column in a source. Lines start at 1 and columns are the number
+// of bytes from the start of the line.
+typedef struct {
+  size_t line;
+  size_t column;
+} yp_line_column_t;
+
+// Initialize a newline list with the start of the first line.
+void
+yp_newline_list_init(yp_newline_list_t *list);
+
+// Append the start of a line to the list.
+void
+yp_newline_list_append(yp_newline_list_t *list, uint32_t offset);
+
+// Record the start of every line that follows a newline in the given source
+// before the given offset that hasn't already been scanned.
+void
+yp_newline_list_scan(yp_newline_list_t *list, const char *source, size_t until);
+
+// Returns the line and column of the given offset, using a binary search over
+// the starts of the lines. Offsets past the end of the source are on the last
+// line.
+__attribute__((__visibility__("default"))) extern yp_line_column_t
+yp_newline_list_line_column(const yp_newline_list_t *list, uint32_t offset);
+
+// Free the memory associated with the newline list.
+void
+yp_newline_list_free(yp_newline_list_t *list);
+
+#endif
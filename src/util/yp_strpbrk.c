@@ -0,0 +1,108 @@
+#include "yp_strpbrk.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define YP_STRPBRK_X86 1
+#include <immintrin.h>
+#endif
+
+// The portable implementation. It builds a 256-bit table of the bytes in the
+// charset so that each byte of the source is checked with a single lookup.
+static const char *
+yp_strpbrk_portable(const char *source, ptrdiff_t length, const char *charset, size_t charset_length) {
+  uint32_t table[8] = { 0 };
+
+  for (size_t index = 0; index < charset_length; index++) {
+    unsigned char byte = (unsigned char) charset[index];
+    table[byte >> 5] |= (uint32_t) 1 << (byte & 31);
+  }
+
+  for (ptrdiff_t index = 0; index < length; index++) {
+    unsigned char byte = (unsigned char) source[index];
+    if (table[byte >> 5] & ((uint32_t) 1 << (byte & 31))) return source + index;
+  }
+
+  return NULL;
+}
+
+#ifdef YP_STRPBRK_X86
+
+// SSE2 is part of the x86-64 baseline, so this is always available there. It
+// compares 16 bytes at a time against each byte in the charset.
+static const char *
+yp_strpbrk_sse2(const char *source, ptrdiff_t length, const char *charset, size_t charset_length) {
+  __m128i needles[YP_STRPBRK_CHARSET_MAXIMUM];
+  for (size_t index = 0; index < charset_length; index++) {
+    needles[index] = _mm_set1_epi8(charset[index]);
+  }
+
+  ptrdiff_t offset = 0;
+  for (; offset + 16 <= length; offset += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *) (source + offset));
+    __m128i matches = _mm_setzero_si128();
+
+    for (size_t index = 0; index < charset_length; index++) {
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, needles[index]));
+    }
+
+    int mask = _mm_movemask_epi8(matches);
+    if (mask != 0) return source + offset + __builtin_ctz((unsigned int) mask);
+  }
+
+  return yp_strpbrk_portable(source + offset, length - offset, charset, charset_length);
+}
+
+// The AVX2 version is the same as the SSE2 version but with 32 bytes at a time.
+// It is only used if the CPU supports it, as checked at runtime.
+__attribute__((target("avx2"))) static const char *
+yp_strpbrk_avx2(const char *source, ptrdiff_t length, const char *charset, size_t charset_length) {
+  __m256i needles[YP_STRPBRK_CHARSET_MAXIMUM];
+  for (size_t index = 0; index < charset_length; index++) {
+    needles[index] = _mm256_set1_epi8(charset[index]);
+  }
+
+  ptrdiff_t offset = 0;
+  for (; offset + 32 <= length; offset += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *) (source + offset));
+    __m256i matches = _mm256_setzero_si256();
+
+    for (size_t index = 0; index < charset_length; index++) {
+      matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(chunk, needles[index]));
+    }
+
+    unsigned int mask = (unsigned int) _mm256_movemask_epi8(matches);
+    if (mask != 0) return source + offset + __builtin_ctz(mask);
+  }
+
+  return yp_strpbrk_sse2(source + offset, length - offset, charset, charset_length);
+}
+
+typedef const char *(*yp_strpbrk_function_t)(const char *, ptrdiff_t, const char *, size_t);
+
+// The implementation to use. It starts as the SSE2 version, which every x86-64
+// CPU supports, and is upgraded when the library is loaded if the CPU supports
+// something wider. Setting it in a constructor means it is never written once
+// anything can be parsing, so threads can read it without synchronizing.
+static yp_strpbrk_function_t yp_strpbrk_selected = yp_strpbrk_sse2;
+
+// Pick the widest implementation that the current CPU supports. This is only
+// done once, since the answer can't change while the process is running.
+__attribute__((constructor)) static void
+yp_strpbrk_select(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) yp_strpbrk_selected = yp_strpbrk_avx2;
+}
+
+#endif
+
+// Returns a pointer to the first byte in the source that is in the charset, or
+// NULL if there isn't one.
+const char *
+yp_strpbrk(const char *source, ptrdiff_t length, const char *charset, size_t charset_length) {
+  if (length <= 0) return NULL;
+
+#ifdef YP_STRPBRK_X86
+  return yp_strpbrk_selected(source, length, charset, charset_length);
+#else
+  return yp_strpbrk_portable(source, length, charset, charset_length);
+#endif
+}
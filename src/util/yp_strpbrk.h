@@ -0,0 +1,20 @@
+#ifndef YARP_STRPBRK_H
+#define YARP_STRPBRK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The maximum number of bytes that can be searched for at once.
+#define YP_STRPBRK_CHARSET_MAXIMUM 8
+
+// Here we have rolled our own version of strpbrk. The standard library strpbrk
+// has undefined behavior when the source string is not null-terminated, and it
+// stops at null bytes, neither of which we want since the source may contain
+// them. This version is bounded by the given length, accepts any byte in the
+// charset (including a null byte), and is vectorized on platforms that support
+// it. It returns a pointer to the first byte in the source that is in the
+// charset, or NULL if there isn't one.
+const char *
+yp_strpbrk(const char *source, ptrdiff_t length, const char *charset, size_t charset_length);
+
+#endif
@@ -0,0 +1,62 @@
+#include "yp_strspn.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define YP_STRSPN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static inline int
+yp_strspn_inline_whitespace_char(char c) {
+  return c == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\r';
+}
+
+// Count the run of whitespace without worrying about the trailing \r\n case,
+// which is handled by the caller.
+static size_t
+yp_strspn_inline_whitespace_run(const char *string, ptrdiff_t length) {
+  ptrdiff_t offset = 0;
+
+#ifdef YP_STRSPN_SSE2
+  // Most runs of whitespace between tokens are a single space, so only bother
+  // with vectors once we know the run is longer than that.
+  if (length >= 16 + 1 && yp_strspn_inline_whitespace_char(string[0]) && yp_strspn_inline_whitespace_char(string[1])) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i form_feed = _mm_set1_epi8('\f');
+    const __m128i vertical_tab = _mm_set1_epi8('\v');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+
+    for (; offset + 16 <= length; offset += 16) {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) (string + offset));
+      __m128i matches = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+        _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, form_feed), _mm_cmpeq_epi8(chunk, vertical_tab)),
+          _mm_cmpeq_epi8(chunk, carriage_return)
+        )
+      );
+
+      unsigned int mask = (unsigned int) _mm_movemask_epi8(matches) ^ 0xFFFF;
+      if (mask != 0) return (size_t) (offset + __builtin_ctz(mask));
+    }
+  }
+#endif
+
+  while (offset < length && yp_strspn_inline_whitespace_char(string[offset])) offset++;
+  return (size_t) offset;
+}
+
+size_t
+yp_strspn_inline_whitespace(const char *string, ptrdiff_t length) {
+  if (length <= 0) return 0;
+
+  size_t size = yp_strspn_inline_whitespace_run(string, length);
+
+  // A carriage return can only appear in the middle of a run if it isn't
+  // followed by a newline, so the last byte is the only one we need to check.
+  if (size > 0 && string[size - 1] == '\r' && (ptrdiff_t) size < length && string[size] == '\n') {
+    size--;
+  }
+
+  return size;
+}
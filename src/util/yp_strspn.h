@@ -0,0 +1,14 @@
+#ifndef YARP_STRSPN_H
+#define YARP_STRSPN_H
+
+#include <stddef.h>
+
+// Returns the number of bytes at the start of the string that are horizontal
+// whitespace (space, tab, form feed, vertical tab, and carriage return). A
+// carriage return that is immediately followed by a newline is not counted,
+// since the lexer treats that pair as a single newline. The search is bounded
+// by the given length and is vectorized on platforms that support it.
+size_t
+yp_strspn_inline_whitespace(const char *string, ptrdiff_t length);
+
+#endif
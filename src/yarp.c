@@ -1,5 +1,8 @@
 #include "yarp.h"
 
+#include <errno.h>
+#include <unistd.h>
+
 #define STRINGIZE0(expr) #expr
 #define STRINGIZE(expr) STRINGIZE0(expr)
 #define YP_VERSION_MACRO STRINGIZE(YP_VERSION_MAJOR) "." STRINGIZE(YP_VERSION_MINOR) "." STRINGIZE(YP_VERSION_PATCH)
@@ -102,15 +105,34 @@ char_is_hexadecimal_number(const char *c) {
   return (*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f') || (*c >= 'A' && *c <= 'F');
 }
 
+// Every encoding that we support is ASCII-compatible, so bytes below 0x80 can
+// be classified without going through the encoding. Bit 0 is set for bytes that
+// can start an identifier and bit 1 is set for bytes that can continue one.
+static const uint8_t ascii_identifier_table[128] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+  0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 3,
+  0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0,
+};
+
 static inline size_t
 char_is_identifier_start(yp_parser_t *parser, const char *c) {
-  return (*c == '_') ? 1 : parser->encoding.alpha_char(c);
+  const unsigned char v = (unsigned char) *c;
+  if (v < 0x80) return ascii_identifier_table[v] & 1;
+  return parser->encoding.alpha_char(c);
 }
 
 static inline size_t
 char_is_identifier(yp_parser_t *parser, const char *c) {
+  const unsigned char v = (unsigned char) *c;
+  if (v < 0x80) return (ascii_identifier_table[v] >> 1) & 1;
+
   size_t width;
-  return (width = parser->encoding.alnum_char(c)) ? width : char_is_identifier_start(parser, c);
+  return (width = parser->encoding.alnum_char(c)) ? width : parser->encoding.alpha_char(c);
 }
 
 static inline bool
@@ -413,10 +435,6 @@ lex_identifier(yp_parser_t *parser) {
   // against known keywords.
   width = parser->current.end - parser->current.start;
 
-#define KEYWORD(value, token) \
-  if (width == sizeof(value) - 1 && strncmp(parser->current.start, value, sizeof(value) - 1) == 0) \
-    return YP_TOKEN_KEYWORD_##token;
-
   if (parser->current.end < parser->end) {
     // If we're in a position where we can accept a = at the end of an
     // identifier, then we'll optionally accept it.
@@ -430,57 +448,18 @@ lex_identifier(yp_parser_t *parser) {
       width++;
 
       if (parser->previous.type != YP_TOKEN_DOT) {
-        KEYWORD("defined?", DEFINED)
+        return yp_keyword_token_type(parser->current.start, width);
       }
 
       return YP_TOKEN_IDENTIFIER;
     }
   }
 
+  // Keywords are never keywords when they're used as method names after a dot.
   if (parser->previous.type != YP_TOKEN_DOT) {
-    KEYWORD("__ENCODING__", __ENCODING__)
-    KEYWORD("__LINE__", __LINE__)
-    KEYWORD("__FILE__", __FILE__)
-    KEYWORD("alias", ALIAS)
-    KEYWORD("and", AND)
-    KEYWORD("begin", BEGIN)
-    KEYWORD("BEGIN", BEGIN_UPCASE)
-    KEYWORD("break", BREAK)
-    KEYWORD("case", CASE)
-    KEYWORD("class", CLASS)
-    KEYWORD("def", DEF)
-    KEYWORD("do", DO)
-    KEYWORD("else", ELSE)
-    KEYWORD("elsif", ELSIF)
-    KEYWORD("end", END)
-    KEYWORD("END", END_UPCASE)
-    KEYWORD("ensure", ENSURE)
-    KEYWORD("false", FALSE)
-    KEYWORD("for", FOR)
-    KEYWORD("if", IF)
-    KEYWORD("in", IN)
-    KEYWORD("module", MODULE)
-    KEYWORD("next", NEXT)
-    KEYWORD("nil", NIL)
-    KEYWORD("not", NOT)
-    KEYWORD("or", OR)
-    KEYWORD("redo", REDO)
-    KEYWORD("rescue", RESCUE)
-    KEYWORD("retry", RETRY)
-    KEYWORD("return", RETURN)
-    KEYWORD("self", SELF)
-    KEYWORD("super", SUPER)
-    KEYWORD("then", THEN)
-    KEYWORD("true", TRUE)
-    KEYWORD("undef", UNDEF)
-    KEYWORD("unless", UNLESS)
-    KEYWORD("until", UNTIL)
-    KEYWORD("when", WHEN)
-    KEYWORD("while", WHILE)
-    KEYWORD("yield", YIELD)
-  }
-
-#undef KEYWORD
+    yp_token_type_t type = yp_keyword_token_type(parser->current.start, width);
+    if (type != YP_TOKEN_IDENTIFIER) return type;
+  }
 
   char start = parser->current.start[0];
   return start >= 'A' && start <= 'Z' ? YP_TOKEN_CONSTANT : YP_TOKEN_IDENTIFIER;
@@ -502,29 +481,16 @@ lex_token_type(yp_parser_t *parser) {
   switch (parser->lex_modes.current->mode) {
     case YP_LEX_DEFAULT:
     case YP_LEX_EMBEXPR: {
+      // If we've already consumed the terminating null byte then we're being
+      // asked to lex past the end of the source, so keep returning EOF.
+      if (parser->current.end > parser->end) {
+        parser->current.start = parser->current.end;
+        return YP_TOKEN_EOF;
+      }
+
       // First, we're going to skip past any whitespace at the front of the next
       // token.
-      bool chomping = true;
-      while (chomping) {
-        switch (*parser->current.end) {
-          case ' ':
-          case '\t':
-          case '\f':
-          case '\v':
-            parser->current.end++;
-            break;
-          case '\r':
-            if (parser->current.end[1] == '\n') {
-              chomping = false;
-            } else {
-              parser->current.end++;
-            }
-            break;
-          default:
-            chomping = false;
-            break;
-        }
-      }
+      parser->current.end += yp_strspn_inline_whitespace(parser->current.end, parser->end - parser->current.end);
 
       // Next, we'll set to start of this token to be the current end.
       parser->current.start = parser->current.end;
@@ -536,12 +502,14 @@ lex_token_type(yp_parser_t *parser) {
         case '\032': // ^Z
           return YP_TOKEN_EOF;
 
-        case '#': // comments
-          while (*parser->current.end != '\n' && *parser->current.end != '\0') {
-            parser->current.end++;
-          }
+        case '#': { // comments
+          // Comments run until the next newline or null byte.
+          const char breakpoints[] = { '\n', '\0' };
+          const char *ending = yp_strpbrk(parser->current.end, parser->end - parser->current.end, breakpoints, sizeof(breakpoints));
+          parser->current.end = ending == NULL ? parser->end : ending;
           (void) match(parser, '\n');
           return YP_TOKEN_COMMENT;
+        }
 
         case '\r': {
           // The only way to get here is if this is immediately followed by a
@@ -882,8 +850,15 @@ lex_token_type(yp_parser_t *parser) {
       // Next, we'll set to start of this token to be the current end.
       parser->current.start = parser->current.end;
 
+      // These are the bytes that can end a word in the list. We'll jump
+      // directly between them instead of checking every byte of the content.
+      const char breakpoints[] = { ' ', '\t', '\n', '\f', '\r', '\v', parser->lex_modes.current->term, '#' };
+      const char *breakpoint = yp_strpbrk(parser->current.end, parser->end - parser->current.end, breakpoints, sizeof(breakpoints));
+
       // Lex as far as we can into the word.
-      while (parser->current.end < parser->end) {
+      while (breakpoint != NULL) {
+        parser->current.end = breakpoint;
+
         // If we've hit whitespace, then we must have received content by now,
         // so we can return an element of the list.
         if (char_is_whitespace(parser->current.end)) {
@@ -906,7 +881,7 @@ lex_token_type(yp_parser_t *parser) {
 
         // If we've hit a #{, then we're at the start of an embedded expression,
         // so we'll switch to the embedded expression lex mode.
-        if (parser->lex_modes.current->interp && parser->current.end[0] == '#' && parser->current.end[1] == '{') {
+        if (parser->lex_modes.current->interp && parser->current.end[1] == '{') {
           // If we've already skipped past content, then we need to return that
           // content first before we switch to the embedded expression lex mode.
           if (parser->current.start < parser->current.end) {
@@ -918,11 +893,12 @@ lex_token_type(yp_parser_t *parser) {
           return YP_TOKEN_EMBEXPR_BEGIN;
         }
 
-        // Otherwise, just skip past the content as it's part of an element of
-        // the list.
-        parser->current.end++;
+        // Otherwise, this # is just part of an element of the list, so we'll
+        // skip past it and find the next breakpoint.
+        breakpoint = yp_strpbrk(breakpoint + 1, parser->end - (breakpoint + 1), breakpoints, sizeof(breakpoints));
       }
 
+      parser->current.end = parser->end;
       return YP_TOKEN_EOF;
     }
     case YP_LEX_REGEXP: {
@@ -956,10 +932,17 @@ lex_token_type(yp_parser_t *parser) {
         return YP_TOKEN_REGEXP_END;
       }
 
+      // These are the bytes that we need to stop at within the regular
+      // expression. Everything else is skipped over in bulk.
+      const char breakpoints[] = { parser->lex_modes.current->term, '#' };
+      const char *breakpoint = yp_strpbrk(parser->current.end, parser->end - parser->current.end, breakpoints, sizeof(breakpoints));
+
       // Otherwise, we'll lex as far as we can into the regular expression. If
       // we hit the end of the regular expression, then we'll return everything
       // up to that point.
-      while (parser->current.end < parser->end) {
+      while (breakpoint != NULL) {
+        parser->current.end = breakpoint;
+
         // If we hit the terminator, then return this element of the string.
         if (*parser->current.end == parser->lex_modes.current->term) {
           return YP_TOKEN_STRING_CONTENT;
@@ -967,26 +950,25 @@ lex_token_type(yp_parser_t *parser) {
 
         // If we've hit a #, then check if it's used as the beginning of either
         // an embedded variable or an embedded expression.
-        if (*parser->current.end == '#') {
-          switch (parser->current.end[1]) {
-            case '{':
-              // In this case it's the start of an embedded expression.
-
-              // If we have already consumed content, then we need to return
-              // that content as string content first.
-              if (parser->current.end > parser->current.start) {
-                return YP_TOKEN_STRING_CONTENT;
-              }
+        switch (parser->current.end[1]) {
+          case '{':
+            // In this case it's the start of an embedded expression.
+
+            // If we have already consumed content, then we need to return
+            // that content as string content first.
+            if (parser->current.end > parser->current.start) {
+              return YP_TOKEN_STRING_CONTENT;
+            }
 
-              parser->current.end += 2;
-              lex_mode_push(parser, (yp_lex_mode_t) { .mode = YP_LEX_EMBEXPR });
-              return YP_TOKEN_EMBEXPR_BEGIN;
-          }
+            parser->current.end += 2;
+            lex_mode_push(parser, (yp_lex_mode_t) { .mode = YP_LEX_EMBEXPR });
+            return YP_TOKEN_EMBEXPR_BEGIN;
         }
 
-        parser->current.end++;
+        breakpoint = yp_strpbrk(breakpoint + 1, parser->end - (breakpoint + 1), breakpoints, sizeof(breakpoints));
       }
 
+      parser->current.end = parser->end;
       return YP_TOKEN_EOF;
     }
     case YP_LEX_STRING: {
@@ -1000,9 +982,16 @@ lex_token_type(yp_parser_t *parser) {
         return YP_TOKEN_STRING_END;
       }
 
+      // These are the bytes that we need to stop at within the string.
+      // Everything else is skipped over in bulk.
+      const char breakpoints[] = { parser->lex_modes.current->term, '#', '\\' };
+      const char *breakpoint = yp_strpbrk(parser->current.end, parser->end - parser->current.end, breakpoints, sizeof(breakpoints));
+
       // Otherwise, we'll lex as far as we can into the string. If we hit the
       // end of the string, then we'll return everything up to that point.
-      while (parser->current.end < parser->end) {
+      while (breakpoint != NULL) {
+        parser->current.end = breakpoint;
+
         // If we hit the terminator, then return this element of the string.
         if (*parser->current.end == parser->lex_modes.current->term) {
           return YP_TOKEN_STRING_CONTENT;
@@ -1040,12 +1029,14 @@ lex_token_type(yp_parser_t *parser) {
           case '\\':
             // If we hit an escape, then we need that handle the subsequent
             // character literally.
-            parser->current.end++;
+            breakpoint++;
+            break;
         }
 
-        parser->current.end++;
+        breakpoint = yp_strpbrk(breakpoint + 1, parser->end - (breakpoint + 1), breakpoints, sizeof(breakpoints));
       }
 
+      parser->current.end = parser->end;
       return YP_TOKEN_EOF;
     }
     case YP_LEX_SYMBOL: {
@@ -1151,10 +1142,32 @@ parser_lex_magic_comments(yp_parser_t *parser) {
 /* Parse functions                                                            */
 /******************************************************************************/
 
+// Record the starts of the lines in the source up to the end of the current
+// token. The end of the token can be one past the end of the source once the
+// lexer reaches the end of the file.
+static inline void
+parser_lex_newlines(yp_parser_t *parser) {
+  const char *end = parser->current.end < parser->end ? parser->current.end : parser->end;
+  yp_newline_list_scan(&parser->newline_list, parser->start, (size_t) (end - parser->start));
+}
+
+// Once the parser has been cancelled with yp_parser_cancel, the lexer acts as
+// though the source ends where it is, so that whatever is lexing or parsing
+// winds down as it would at the end of the source.
+static inline bool
+parser_lex_cancelled(yp_parser_t *parser) {
+  if (!__atomic_load_n(&parser->cancelled, __ATOMIC_RELAXED)) return false;
+
+  parser->current.start = parser->current.end;
+  parser->current.type = YP_TOKEN_EOF;
+  return true;
+}
+
 // Get the next token type and skip over comment tokens.
 static void
 parser_lex(yp_parser_t *parser) {
   parser->previous = parser->current;
+  if (parser_lex_cancelled(parser)) return;
   parser->current.type = lex_token_type(parser);
 
   while (
@@ -1210,6 +1223,8 @@ parser_lex(yp_parser_t *parser) {
 
     yp_list_append(&parser->comment_list, (yp_list_node_t *) comment);
   }
+
+  parser_lex_newlines(parser);
 }
 
 static bool
@@ -1278,6 +1293,107 @@ context_pop(yp_parser_t *parser) {
   }
 }
 
+// Push a new local variable scope onto the stack, backed by the given Scope
+// node.
+static void
+scope_push(yp_parser_t *parser, yp_node_t *node) {
+  yp_scope_node_t *scope_node = (yp_scope_node_t *) malloc(sizeof(yp_scope_node_t));
+  *scope_node = (yp_scope_node_t) { .node = node, .slots = NULL, .capacity = 0, .size = 0, .prev = parser->current_scope };
+  parser->current_scope = scope_node;
+}
+
+// Pop the current local variable scope off the stack.
+static void
+scope_pop(yp_parser_t *parser) {
+  yp_scope_node_t *prev = parser->current_scope->prev;
+  free(parser->current_scope->slots);
+  free(parser->current_scope);
+  parser->current_scope = prev;
+}
+
+// Find the slot in the current scope's hash set that either holds the given
+// name or is the empty slot where it would be inserted. The set must have been
+// allocated already.
+static yp_scope_slot_t *
+scope_local_slot(yp_parser_t *parser, const char *start, const char *end, uint32_t hash) {
+  yp_scope_node_t *scope = parser->current_scope;
+  yp_token_list_t *locals = &((yp_scope_t *) scope->node)->locals;
+  uint32_t mask = scope->capacity - 1;
+  uint32_t length = (uint32_t) (end - start);
+
+  for (uint32_t index = hash & mask;; index = (index + 1) & mask) {
+    yp_scope_slot_t *slot = &scope->slots[index];
+    if (slot->index == 0) return slot;
+
+    if (slot->hash == hash) {
+      yp_node_token_t *local = &locals->tokens[slot->index - 1];
+      if (local->end - local->start == length && memcmp(parser->start + local->start, start, length) == 0) return slot;
+    }
+  }
+}
+
+// Double the capacity of the current scope's hash set (or allocate it if it's
+// empty) and reinsert all of the existing names.
+static void
+scope_locals_resize(yp_parser_t *parser) {
+  yp_scope_node_t *scope = parser->current_scope;
+  uint32_t capacity = scope->capacity == 0 ? 8 : scope->capacity * 2;
+  yp_scope_slot_t *slots = (yp_scope_slot_t *) calloc(capacity, sizeof(yp_scope_slot_t));
+
+  for (uint32_t index = 0; index < scope->capacity; index++) {
+    yp_scope_slot_t *slot = &scope->slots[index];
+    if (slot->index == 0) continue;
+
+    uint32_t target = slot->hash & (capacity - 1);
+    while (slots[target].index != 0) target = (target + 1) & (capacity - 1);
+    slots[target] = *slot;
+  }
+
+  free(scope->slots);
+  scope->slots = slots;
+  scope->capacity = capacity;
+}
+
+// Add the name at the given index in the current scope's ordered list of locals
+// to the hash set if it's not already there.
+static void
+scope_local_insert(yp_parser_t *parser, size_t index) {
+  yp_scope_node_t *scope = parser->current_scope;
+  yp_node_token_t *local = &((yp_scope_t *) scope->node)->locals.tokens[index];
+  const char *start = parser->start + local->start;
+  const char *end = parser->start + local->end;
+
+  // Keep the load factor of the set at or below three quarters.
+  if ((scope->size + 1) * 4 > scope->capacity * 3) scope_locals_resize(parser);
+
+  uint32_t hash = yp_constant_pool_hash(start, (size_t) (end - start));
+  yp_scope_slot_t *slot = scope_local_slot(parser, start, end, hash);
+
+  if (slot->index == 0) {
+    *slot = (yp_scope_slot_t) { .hash = hash, .index = (uint32_t) index + 1 };
+    scope->size++;
+  }
+}
+
+// Add a local variable to the current scope. The name is always appended to the
+// scope's ordered list, and is added to the hash set if it's not already there.
+static void
+scope_local_add(yp_parser_t *parser, yp_token_t *token) {
+  yp_token_list_t *locals = &((yp_scope_t *) parser->current_scope->node)->locals;
+  yp_token_list_append(parser, locals, token);
+  scope_local_insert(parser, locals->size - 1);
+}
+
+// Check if the current scope has a local variable with the same name as the
+// given token.
+static bool
+scope_local_includes(yp_parser_t *parser, yp_token_t *token) {
+  if (parser->current_scope->size == 0) return false;
+
+  uint32_t hash = yp_constant_pool_hash(token->start, (size_t) (token->end - token->start));
+  return scope_local_slot(parser, token->start, token->end, hash)->index != 0;
+}
+
 // These are the various precedence rules. Because we are using a Pratt parser,
 // they are named binding power to represent the manner in which nodes are bound
 // together in the stack.
@@ -1523,25 +1639,78 @@ parse_targets(yp_parser_t *parser, binding_power_t binding_power, const char *me
   yp_node_t *multi_target = yp_node_multi_target_node_create(parser);
   yp_node_t *target;
 
-  yp_node_list_append(parser, multi_target, &multi_target->as.multi_target_node.targets, first_target);
+  yp_node_list_append(parser, multi_target, &((yp_multi_target_node_t *) multi_target)->targets, first_target);
 
   while(accept(parser, YP_TOKEN_COMMA)) {
     target = parse_expression(parser, binding_power, message);
-    yp_node_list_append(parser, multi_target, &multi_target->as.multi_target_node.targets, target);
+    yp_node_list_append(parser, multi_target, &((yp_multi_target_node_t *) multi_target)->targets, target);
   }
 
   return multi_target;
 }
 
-// Parse a list of statements separated by newlines or semicolons.
-static yp_node_t *
-parse_statements(yp_parser_t *parser, yp_context_t context) {
-  context_push(parser, context);
-  yp_node_t *statements = yp_node_statements_create(parser);
+// Whether or not the statements in the given context are parsed with
+// checkpoints between them, so that yp_reparse can resume parsing there.
+static inline bool
+context_checkpointed(yp_context_t context) {
+  switch (context) {
+    case YP_CONTEXT_MAIN:
+    case YP_CONTEXT_MODULE:
+    case YP_CONTEXT_CLASS:
+    case YP_CONTEXT_DEF:
+    case YP_CONTEXT_SCLASS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Record the current state of the parser while it is parsing the body of the
+// given Statements node.
+static void
+parser_checkpoint(yp_parser_t *parser, const yp_node_t *statements, bool closing) {
+  if (parser->checkpoints.size == parser->checkpoints.capacity) {
+    parser->checkpoints.capacity = parser->checkpoints.capacity == 0 ? 16 : parser->checkpoints.capacity * 2;
+    parser->checkpoints.values = realloc(parser->checkpoints.values, parser->checkpoints.capacity * sizeof(yp_checkpoint_t));
+  }
+
+  parser->checkpoints.values[parser->checkpoints.size++] = (yp_checkpoint_t) {
+    .statements = statements,
+    .index = (uint32_t) ((yp_statements_t *) statements)->body.size,
+    .closing = closing,
+    .recovering = parser->recovering,
+    .previous_type = parser->previous.type,
+    .previous_start = (uint32_t) (parser->previous.start - parser->start),
+    .previous_end = (uint32_t) (parser->previous.end - parser->start),
+    .current_type = parser->current.type,
+    .current_start = (uint32_t) (parser->current.start - parser->start),
+    .current_end = (uint32_t) (parser->current.end - parser->start),
+    .errors = parser->error_list.size,
+    .encoding = parser->encoding
+  };
+}
+
+typedef struct yp_reparse yp_reparse_t;
+
+static bool
+reparse_caught_up(yp_parser_t *parser, yp_reparse_t *reparse);
+
+// Parse statements separated by newlines or semicolons onto the end of the
+// given Statements node. If a reparse is given, then this stops early as soon
+// as the parser is in the same state that it was in at a checkpoint of the
+// previous parse.
+static void
+parse_statements_body(yp_parser_t *parser, yp_context_t context, yp_node_t *statements, yp_reparse_t *reparse) {
+  bool checkpointed = parser->reparseable && context_checkpointed(context);
 
   while (!context_terminator(context, &parser->current)) {
+    if (checkpointed) {
+      if (reparse != NULL && reparse_caught_up(parser, reparse)) return;
+      parser_checkpoint(parser, statements, false);
+    }
+
     yp_node_t *node = parse_expression(parser, BINDING_POWER_NONE, "Expected to be able to parse an expression.");
-    yp_node_list_append(parser, statements, &statements->as.statements.body, node);
+    yp_node_list_append(parser, statements, &((yp_statements_t *) statements)->body, node);
 
     // If we're recovering from a syntax error, then we need to stop parsing the
     // statements now.
@@ -1555,6 +1724,17 @@ parse_statements(yp_parser_t *parser, yp_context_t context) {
     if (!accept_any(parser, 2, YP_TOKEN_NEWLINE, YP_TOKEN_SEMICOLON)) break;
   }
 
+  if (checkpointed) parser_checkpoint(parser, statements, true);
+}
+
+// Parse a list of statements separated by newlines or semicolons.
+static yp_node_t *
+parse_statements(yp_parser_t *parser, yp_context_t context) {
+  context_push(parser, context);
+  yp_node_t *statements = yp_node_statements_create(parser);
+
+  parse_statements_body(parser, context, statements, NULL);
+
   context_pop(parser);
   return statements;
 }
@@ -1579,7 +1759,7 @@ parse_arguments(yp_parser_t *parser, yp_node_t *arguments) {
       // parsing the arguments entirely now.
       if (parser->recovering) break;
 
-      yp_node_list_append(parser, arguments, &arguments->as.arguments_node.arguments, expression);
+      yp_node_list_append(parser, arguments, &((yp_arguments_node_t *) arguments)->arguments, expression);
 
       if (accept(parser, YP_TOKEN_PARENTHESIS_RIGHT)) break;
       expect(parser, YP_TOKEN_COMMA, "Expected an ',' to delimit arguments.");
@@ -1628,13 +1808,13 @@ parse_parameters(yp_parser_t *parser) {
 
         if (accept(parser, YP_TOKEN_IDENTIFIER)) {
           name = parser->previous;
-          yp_token_list_append(&parser->current_scope->as.scope.locals, &name);
+          scope_local_add(parser, &name);
         } else {
           not_provided(&name, parser->previous.end);
         }
 
         yp_node_t *param = yp_node_block_parameter_node_create(parser, &operator, &name);
-        params->as.parameters_node.block = param;
+        ((yp_parameters_node_t *) params)->block = param;
         if (!accept(parser, YP_TOKEN_COMMA)) parsing = false;
         break;
       }
@@ -1642,7 +1822,7 @@ parse_parameters(yp_parser_t *parser) {
         parser_lex(parser);
 
         yp_node_t *param = yp_node_forwarding_parameter_node_create(parser, &parser->previous);
-        params->as.parameters_node.keyword_rest = param;
+        ((yp_parameters_node_t *) params)->keyword_rest = param;
         if (!accept(parser, YP_TOKEN_COMMA)) parsing = false;
         break;
       }
@@ -1650,14 +1830,14 @@ parse_parameters(yp_parser_t *parser) {
         parser_lex(parser);
 
         yp_token_t name = parser->previous;
-        yp_token_list_append(&parser->current_scope->as.scope.locals, &name);
+        scope_local_add(parser, &name);
 
         if (accept(parser, YP_TOKEN_EQUAL)) {
           yp_token_t operator = parser->previous;
           yp_node_t *value = parse_expression(parser, BINDING_POWER_NONE, "Expected to find a default value for the parameter.");
 
           yp_node_t *param = yp_node_optional_parameter_node_create(parser, &name, &operator, value);
-          yp_node_list_append(parser, params, &params->as.parameters_node.optionals, param);
+          yp_node_list_append(parser, params, &((yp_parameters_node_t *) params)->optionals, param);
 
           // If parsing the value of the parameter resulted in error recovery,
           // then we can put a missing node in its place and stop parsing the
@@ -1665,7 +1845,7 @@ parse_parameters(yp_parser_t *parser) {
           if (parser->recovering) return params;
         } else {
           yp_node_t *param = yp_node_required_parameter_node_create(parser, &name);
-          yp_node_list_append(parser, params, &params->as.parameters_node.requireds, param);
+          yp_node_list_append(parser, params, &((yp_parameters_node_t *) params)->requireds, param);
         }
 
         if (!accept(parser, YP_TOKEN_COMMA)) parsing = false;
@@ -1677,10 +1857,10 @@ parse_parameters(yp_parser_t *parser) {
         yp_token_t name = parser->previous;
         yp_token_t local = name;
         local.end -= 1;
-        yp_token_list_append(&parser->current_scope->as.scope.locals, &local);
+        scope_local_add(parser, &local);
 
         yp_node_t *param = yp_node_keyword_parameter_node_create(parser, &name);
-        yp_node_list_append(parser, params, &params->as.parameters_node.keywords, param);
+        yp_node_list_append(parser, params, &((yp_parameters_node_t *) params)->keywords, param);
         if (!accept(parser, YP_TOKEN_COMMA)) parsing = false;
         break;
       }
@@ -1692,13 +1872,13 @@ parse_parameters(yp_parser_t *parser) {
 
         if (accept(parser, YP_TOKEN_IDENTIFIER)) {
           name = parser->previous;
-          yp_token_list_append(&parser->current_scope->as.scope.locals, &name);
+          scope_local_add(parser, &name);
         } else {
           not_provided(&name, parser->previous.end);
         }
 
         yp_node_t *param = yp_node_rest_parameter_node_create(parser, &operator, &name);
-        params->as.parameters_node.rest = param;
+        ((yp_parameters_node_t *) params)->rest = param;
         if (!accept(parser, YP_TOKEN_COMMA)) parsing = false;
         break;
       }
@@ -1710,13 +1890,13 @@ parse_parameters(yp_parser_t *parser) {
 
         if (accept(parser, YP_TOKEN_IDENTIFIER)) {
           name = parser->previous;
-          yp_token_list_append(&parser->current_scope->as.scope.locals, &name);
+          scope_local_add(parser, &name);
         } else {
           not_provided(&name, parser->previous.end);
         }
 
         yp_node_t *param = yp_node_keyword_rest_parameter_node_create(parser, &operator, &name);
-        params->as.parameters_node.keyword_rest = param;
+        ((yp_parameters_node_t *) params)->keyword_rest = param;
         if (!accept(parser, YP_TOKEN_COMMA)) parsing = false;
         break;
       }
@@ -1772,7 +1952,7 @@ parse_conditional(yp_parser_t *parser, yp_context_t context) {
     accept_any(parser, 2, YP_TOKEN_NEWLINE, YP_TOKEN_SEMICOLON);
 
     yp_node_t *elsif = yp_node_if_node_create(parser, &elsif_keyword, predicate, statements, NULL, &end_keyword);
-    current->as.if_node.consequent = elsif;
+    ((yp_if_node_t *) current)->consequent = elsif;
     current = elsif;
   }
 
@@ -1786,18 +1966,18 @@ parse_conditional(yp_parser_t *parser, yp_context_t context) {
       expect(parser, YP_TOKEN_KEYWORD_END, "Expected `end` to close `else` clause.");
 
       yp_node_t *else_node = yp_node_else_node_create(parser, &else_keyword, else_statements, &parser->previous);
-      current->as.if_node.consequent = else_node;
-      parent->as.if_node.end_keyword = parser->previous;
+      ((yp_if_node_t *) current)->consequent = else_node;
+      ((yp_if_node_t *) parent)->end_keyword = yp_node_token_pack(parser, &parser->previous);
       break;
     }
     case YP_TOKEN_KEYWORD_END: {
       parser_lex(parser);
-      parent->as.if_node.end_keyword = parser->previous;
+      ((yp_if_node_t *) parent)->end_keyword = yp_node_token_pack(parser, &parser->previous);
       break;
     }
     default:
       expect(parser, YP_TOKEN_KEYWORD_END, "Expected `end` to close `if` statement.");
-      parent->as.if_node.end_keyword = parser->previous;
+      ((yp_if_node_t *) parent)->end_keyword = yp_node_token_pack(parser, &parser->previous);
       break;
   }
 
@@ -1832,7 +2012,7 @@ parse_symbol(yp_parser_t *parser, int mode) {
           yp_token_t string_content_closing;
           not_provided(&string_content_closing, parser->previous.end);
 
-          yp_node_list_append(parser, interpolated, &interpolated->as.interpolated_symbol_node.parts, yp_node_string_node_create(parser, &string_content_opening, &parser->previous, &string_content_closing));
+          yp_node_list_append(parser, interpolated, &((yp_interpolated_symbol_node_t *) interpolated)->parts, yp_node_string_node_create(parser, &string_content_opening, &parser->previous, &string_content_closing));
           break;
         }
         case YP_TOKEN_EMBEXPR_BEGIN: {
@@ -1840,7 +2020,7 @@ parse_symbol(yp_parser_t *parser, int mode) {
           yp_token_t embexpr_opening = parser->previous;
           yp_node_t *statements = parse_statements(parser, YP_CONTEXT_EMBEXPR);
           expect(parser, YP_TOKEN_EMBEXPR_END, "Expected a closing delimiter for an embedded expression.");
-          yp_node_list_append(parser, interpolated, &interpolated->as.interpolated_symbol_node.parts, yp_node_string_interpolated_node_create(parser, &embexpr_opening, statements, &parser->previous));
+          yp_node_list_append(parser, interpolated, &((yp_interpolated_symbol_node_t *) interpolated)->parts, yp_node_string_interpolated_node_create(parser, &embexpr_opening, statements, &parser->previous));
           break;
         }
         default:
@@ -1850,7 +2030,7 @@ parse_symbol(yp_parser_t *parser, int mode) {
     }
 
     expect(parser, YP_TOKEN_STRING_END, "Expected a closing delimiter for an interpolated symbol.");
-    interpolated->as.interpolated_symbol_node.closing = parser->previous;
+    ((yp_interpolated_symbol_node_t *) interpolated)->closing = yp_node_token_pack(parser, &parser->previous);
     return interpolated;
   }
 
@@ -1905,16 +2085,16 @@ parse_expression_prefix(yp_parser_t *parser) {
       yp_node_t *array = yp_node_array_node_create(parser, &opening, &opening);
 
       while (parser->current.type != YP_TOKEN_BRACKET_RIGHT && parser->current.type != YP_TOKEN_EOF) {
-        if (array->as.array_node.elements.size != 0) {
+        if (((yp_array_node_t *) array)->elements.size != 0) {
           expect(parser, YP_TOKEN_COMMA, "Expected a separator for the elements in an array.");
         }
 
         yp_node_t *element = parse_expression(parser, BINDING_POWER_DEFINED, "Expected an element for the array.");
-        yp_node_list_append(parser, array, &array->as.array_node.elements, element);
+        yp_node_list_append(parser, array, &((yp_array_node_t *) array)->elements, element);
       }
 
       expect(parser, YP_TOKEN_BRACKET_RIGHT, "Expected a closing bracket for the array.");
-      array->as.array_node.closing = parser->previous;
+      ((yp_array_node_t *) array)->closing = yp_node_token_pack(parser, &parser->previous);
 
       return array;
     }
@@ -1945,13 +2125,13 @@ parse_expression_prefix(yp_parser_t *parser) {
         (parser->current.type != YP_TOKEN_PARENTHESIS_LEFT) &&
         (parser->previous.end[-1] != '!') &&
         (parser->previous.end[-1] != '?') &&
-        yp_token_list_includes(&parser->current_scope->as.scope.locals, &parser->previous)
+        scope_local_includes(parser, &parser->previous)
       ) {
         return yp_node_local_variable_read_create(parser, &parser->previous);
       }
 
-      yp_string_t *name = yp_string_alloc();
-      yp_string_shared_init(name, parser->previous.start, parser->previous.end);
+      yp_string_t name;
+      yp_string_shared_init(&name, parser->previous.start, parser->previous.end);
 
       yp_token_t message = parser->previous;
 
@@ -1961,7 +2141,7 @@ parse_expression_prefix(yp_parser_t *parser) {
       yp_arguments_t arguments;
       parse_arguments_list(parser, &arguments);
 
-      return yp_node_call_node_create(parser, NULL, &call_operator, &message, &arguments.opening, arguments.arguments, &arguments.closing, name);
+      return yp_node_call_node_create(parser, NULL, &call_operator, &message, &arguments.opening, arguments.arguments, &arguments.closing, &name);
     }
     case YP_TOKEN_IMAGINARY_NUMBER:
       return yp_node_imaginary_literal_create(parser, &parser->previous);
@@ -2035,13 +2215,12 @@ parse_expression_prefix(yp_parser_t *parser) {
         accept_any(parser, 2, YP_TOKEN_NEWLINE, YP_TOKEN_SEMICOLON);
 
         yp_node_t *scope = yp_node_scope_create(parser);
-        yp_node_t *parent_scope = parser->current_scope;
-        parser->current_scope = scope;
+        scope_push(parser, scope);
 
         yp_node_t *statements = parse_statements(parser, YP_CONTEXT_SCLASS);
         expect(parser, YP_TOKEN_KEYWORD_END, "Expected `end` to close `class` statement.");
 
-        parser->current_scope = parent_scope;
+        scope_pop(parser);
         return yp_node_s_class_node_create(parser, scope, &class_keyword, &operator, expression, statements, &parser->previous);
       }
 
@@ -2058,13 +2237,12 @@ parse_expression_prefix(yp_parser_t *parser) {
       }
 
       yp_node_t *scope = yp_node_scope_create(parser);
-      yp_node_t *parent_scope = parser->current_scope;
-      parser->current_scope = scope;
+      scope_push(parser, scope);
 
       yp_node_t *statements = parse_statements(parser, YP_CONTEXT_CLASS);
       expect(parser, YP_TOKEN_KEYWORD_END, "Expected `end` to close `class` statement.");
 
-      parser->current_scope = parent_scope;
+      scope_pop(parser);
       return yp_node_class_node_create(parser, scope, &class_keyword, name, &inheritance_operator, superclass, statements, &parser->previous);
     }
     case YP_TOKEN_KEYWORD_DEF: {
@@ -2082,9 +2260,8 @@ parse_expression_prefix(yp_parser_t *parser) {
         not_provided(&lparen, parser->previous.end);
       }
 
-      yp_node_t *parent_scope = parser->current_scope;
       yp_node_t *scope = yp_node_scope_create(parser);
-      parser->current_scope = scope;
+      scope_push(parser, scope);
       yp_node_t *params = parse_parameters(parser);
 
       if (lparen.type == YP_TOKEN_PARENTHESIS_LEFT) {
@@ -2114,7 +2291,7 @@ parse_expression_prefix(yp_parser_t *parser) {
         end_keyword = parser->previous;
       }
 
-      parser->current_scope = parent_scope;
+      scope_pop(parser);
       return yp_node_def_node_create(parser, &def_keyword, &name, &lparen, params, &rparen, &equal, statements, &end_keyword, scope);
     }
     case YP_TOKEN_KEYWORD_DEFINED: {
@@ -2169,14 +2346,13 @@ parse_expression_prefix(yp_parser_t *parser) {
       }
 
       yp_node_t *scope = yp_node_scope_create(parser);
-      yp_node_t *parent_scope = parser->current_scope;
-      parser->current_scope = scope;
+      scope_push(parser, scope);
 
       accept(parser, YP_TOKEN_SEMICOLON);
       accept(parser, YP_TOKEN_NEWLINE);
 
       yp_node_t *statements = parse_statements(parser, YP_CONTEXT_FOR);
-      parser->current_scope = parent_scope;
+      scope_pop(parser);
 
       expect(parser, YP_TOKEN_KEYWORD_END, "Expected `end` to close for loop.");
       yp_token_t end_keyword = parser->previous;
@@ -2192,13 +2368,13 @@ parse_expression_prefix(yp_parser_t *parser) {
       yp_node_t *name = parse_alias_or_undef_argument(parser);
       if (name->type == YP_NODE_MISSING_NODE) return undef;
 
-      yp_node_list_append(parser, undef, &undef->as.undef_node.names, name);
+      yp_node_list_append(parser, undef, &((yp_undef_node_t *) undef)->names, name);
 
       while (accept(parser, YP_TOKEN_COMMA)) {
         name = parse_alias_or_undef_argument(parser);
         if (name->type == YP_NODE_MISSING_NODE) return undef;
 
-        yp_node_list_append(parser, undef, &undef->as.undef_node.names, name);
+        yp_node_list_append(parser, undef, &((yp_undef_node_t *) undef)->names, name);
       }
 
       return undef;
@@ -2220,11 +2396,10 @@ parse_expression_prefix(yp_parser_t *parser) {
       }
 
       yp_node_t *scope = yp_node_scope_create(parser);
-      yp_node_t *parent_scope = parser->current_scope;
-      parser->current_scope = scope;
+      scope_push(parser, scope);
 
       yp_node_t *statements = parse_statements(parser, YP_CONTEXT_MODULE);
-      parser->current_scope = parent_scope;
+      scope_pop(parser);
 
       expect(parser, YP_TOKEN_KEYWORD_END, "Expected `end` to close `module` statement.");
       return yp_node_module_node_create(parser, scope, &module_keyword, name, statements, &parser->previous);
@@ -2268,7 +2443,7 @@ parse_expression_prefix(yp_parser_t *parser) {
       yp_node_t *array = yp_node_array_node_create(parser, &opening, &opening);
 
       while (parser->current.type != YP_TOKEN_STRING_END && parser->current.type != YP_TOKEN_EOF) {
-        if (array->as.array_node.elements.size == 0) {
+        if (((yp_array_node_t *) array)->elements.size == 0) {
           accept(parser, YP_TOKEN_WORDS_SEP);
         } else {
           expect(parser, YP_TOKEN_WORDS_SEP, "Expected a separator for the symbols in a `%i` list.");
@@ -2282,11 +2457,11 @@ parse_expression_prefix(yp_parser_t *parser) {
         not_provided(&closing, parser->previous.end);
 
         yp_node_t *symbol = yp_node_symbol_node_create(parser, &opening, &parser->previous, &closing);
-        yp_node_list_append(parser, array, &array->as.array_node.elements, symbol);
+        yp_node_list_append(parser, array, &((yp_array_node_t *) array)->elements, symbol);
       }
 
       expect(parser, YP_TOKEN_STRING_END, "Expected a closing delimiter for a `%i` list.");
-      array->as.array_node.closing = parser->previous;
+      ((yp_array_node_t *) array)->closing = yp_node_token_pack(parser, &parser->previous);
 
       return array;
     }
@@ -2295,7 +2470,7 @@ parse_expression_prefix(yp_parser_t *parser) {
       yp_node_t *array = yp_node_array_node_create(parser, &opening, &opening);
 
       while (parser->current.type != YP_TOKEN_STRING_END && parser->current.type != YP_TOKEN_EOF) {
-        if (array->as.array_node.elements.size == 0) {
+        if (((yp_array_node_t *) array)->elements.size == 0) {
           accept(parser, YP_TOKEN_WORDS_SEP);
         } else {
           expect(parser, YP_TOKEN_WORDS_SEP, "Expected a separator for the strings in a `%w` list.");
@@ -2309,11 +2484,11 @@ parse_expression_prefix(yp_parser_t *parser) {
         not_provided(&closing, parser->previous.end);
 
         yp_node_t *string = yp_node_string_node_create(parser, &opening, &parser->previous, &closing);
-        yp_node_list_append(parser, array, &array->as.array_node.elements, string);
+        yp_node_list_append(parser, array, &((yp_array_node_t *) array)->elements, string);
       }
 
       expect(parser, YP_TOKEN_STRING_END, "Expected a closing delimiter for a `%w` list.");
-      array->as.array_node.closing = parser->previous;
+      ((yp_array_node_t *) array)->closing = yp_node_token_pack(parser, &parser->previous);
 
       return array;
     }
@@ -2331,7 +2506,7 @@ parse_expression_prefix(yp_parser_t *parser) {
             } else {
               // If we hit a separator after we've hit content, then we need to
               // append that content to the list and reset the current node.
-              yp_node_list_append(parser, array, &array->as.array_node.elements, current);
+              yp_node_list_append(parser, array, &((yp_array_node_t *) array)->elements, current);
               current = NULL;
             }
 
@@ -2363,7 +2538,7 @@ parse_expression_prefix(yp_parser_t *parser) {
               not_provided(&closing, parser->previous.end);
 
               yp_node_t *next_string = yp_node_string_node_create(parser, &opening, &parser->previous, &closing);
-              yp_node_list_append(parser, current, &current->as.interpolated_string_node.parts, next_string);
+              yp_node_list_append(parser, current, &((yp_interpolated_string_node_t *) current)->parts, next_string);
             }
 
             break;
@@ -2394,7 +2569,7 @@ parse_expression_prefix(yp_parser_t *parser) {
               not_provided(&closing, parser->previous.start);
 
               yp_node_t *interpolated = yp_node_interpolated_string_node_create(parser, &opening, &closing);
-              yp_node_list_append(parser, interpolated, &interpolated->as.interpolated_string_node.parts, current);
+              yp_node_list_append(parser, interpolated, &((yp_interpolated_string_node_t *) interpolated)->parts, current);
               current = interpolated;
             } else if (current->type == YP_NODE_INTERPOLATED_STRING_NODE) {
               // If we hit an embedded expression and the current node is an
@@ -2407,7 +2582,7 @@ parse_expression_prefix(yp_parser_t *parser) {
 
             yp_token_t embexpr_closing = parser->previous;
             yp_node_t *interpolated = yp_node_string_interpolated_node_create(parser, &embexpr_opening, statements, &embexpr_closing);
-            yp_node_list_append(parser, current, &current->as.interpolated_string_node.parts, interpolated);
+            yp_node_list_append(parser, current, &((yp_interpolated_string_node_t *) current)->parts, interpolated);
             break;
           }
           default:
@@ -2419,11 +2594,11 @@ parse_expression_prefix(yp_parser_t *parser) {
 
       // If we have a current node, then we need to append it to the list.
       if (current) {
-        yp_node_list_append(parser, array, &array->as.array_node.elements, current);
+        yp_node_list_append(parser, array, &((yp_array_node_t *) array)->elements, current);
       }
 
       expect(parser, YP_TOKEN_STRING_END, "Expected a closing delimiter for a `%W` list.");
-      array->as.array_node.closing = parser->previous;
+      ((yp_array_node_t *) array)->closing = yp_node_token_pack(parser, &parser->previous);
       return array;
     }
     case YP_TOKEN_RATIONAL_NUMBER:
@@ -2456,10 +2631,10 @@ parse_expression_prefix(yp_parser_t *parser) {
 
       yp_node_t *receiver = parse_expression(parser, binding_powers[parser->previous.type].right, "Expected a receiver after unary operator.");
 
-      yp_string_t *name = yp_string_alloc();
-      yp_string_shared_init(name, operator_token.start, operator_token.end);
+      yp_string_t name;
+      yp_string_shared_init(&name, operator_token.start, operator_token.end);
 
-      return yp_node_call_node_create(parser, receiver, &call_operator, &operator_token, &lparen, NULL, &rparen, name);
+      return yp_node_call_node_create(parser, receiver, &call_operator, &operator_token, &lparen, NULL, &rparen, &name);
     }
     case YP_TOKEN_MINUS: {
       yp_token_t operator_token = parser->previous;
@@ -2475,10 +2650,10 @@ parse_expression_prefix(yp_parser_t *parser) {
 
       yp_node_t *receiver = parse_expression(parser, binding_powers[parser->previous.type].right, "Expected a receiver after unary -.");
 
-      yp_string_t *name = yp_string_alloc();
-      yp_string_constant_init(name, "-@", 2);
+      yp_string_t name;
+      yp_string_constant_init(&name, "-@", 2);
 
-      return yp_node_call_node_create(parser, receiver, &call_operator, &operator_token, &lparen, NULL, &rparen, name);
+      return yp_node_call_node_create(parser, receiver, &call_operator, &operator_token, &lparen, NULL, &rparen, &name);
     }
     case YP_TOKEN_PLUS: {
       yp_token_t operator_token = parser->previous;
@@ -2494,10 +2669,10 @@ parse_expression_prefix(yp_parser_t *parser) {
 
       yp_node_t *receiver = parse_expression(parser, binding_powers[parser->previous.type].right, "Expected a receiver after unary +.");
 
-      yp_string_t *name = yp_string_alloc();
-      yp_string_constant_init(name, "+@", 2);
+      yp_string_t name;
+      yp_string_constant_init(&name, "+@", 2);
 
-      return yp_node_call_node_create(parser, receiver, &call_operator, &operator_token, &lparen, NULL, &rparen, name);
+      return yp_node_call_node_create(parser, receiver, &call_operator, &operator_token, &lparen, NULL, &rparen, &name);
     }
     case YP_TOKEN_STRING_BEGIN: {
       yp_token_t opening = parser->previous;
@@ -2516,7 +2691,7 @@ parse_expression_prefix(yp_parser_t *parser) {
               yp_token_t string_content_closing;
               not_provided(&string_content_closing, parser->previous.end);
 
-              yp_node_list_append(parser, interpolated, &interpolated->as.interpolated_string_node.parts, yp_node_string_node_create(parser, &string_content_opening, &parser->previous, &string_content_closing));
+              yp_node_list_append(parser, interpolated, &((yp_interpolated_string_node_t *) interpolated)->parts, yp_node_string_node_create(parser, &string_content_opening, &parser->previous, &string_content_closing));
               break;
             }
             case YP_TOKEN_EMBEXPR_BEGIN: {
@@ -2524,7 +2699,7 @@ parse_expression_prefix(yp_parser_t *parser) {
               yp_token_t embexpr_opening = parser->previous;
               yp_node_t *statements = parse_statements(parser, YP_CONTEXT_EMBEXPR);
               expect(parser, YP_TOKEN_EMBEXPR_END, "Expected a closing delimiter for an embedded expression.");
-              yp_node_list_append(parser, interpolated, &interpolated->as.interpolated_string_node.parts, yp_node_string_interpolated_node_create(parser, &embexpr_opening, statements, &parser->previous));
+              yp_node_list_append(parser, interpolated, &((yp_interpolated_string_node_t *) interpolated)->parts, yp_node_string_interpolated_node_create(parser, &embexpr_opening, statements, &parser->previous));
               break;
             }
             default:
@@ -2534,7 +2709,7 @@ parse_expression_prefix(yp_parser_t *parser) {
         }
 
         expect(parser, YP_TOKEN_STRING_END, "Expected a closing delimiter for an interpolated string.");
-        interpolated->as.interpolated_string_node.closing = parser->previous;
+        ((yp_interpolated_string_node_t *) interpolated)->closing = yp_node_token_pack(parser, &parser->previous);
         return interpolated;
       }
 
@@ -2572,7 +2747,8 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
           yp_node_t *value = parse_expression(parser, binding_power, "Expected a value for the class variable after =.");
           yp_node_t *read = node;
 
-          yp_node_t *result = yp_node_class_variable_write_create(parser, &node->as.class_variable_read.name, &token, value);
+          yp_token_t name = yp_node_token_unpack(parser, &((yp_class_variable_read_t *) node)->name);
+          yp_node_t *result = yp_node_class_variable_write_create(parser, &name, &token, value);
           yp_node_destroy(parser, read);
           return result;
         }
@@ -2585,7 +2761,8 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
           yp_node_t *value = parse_expression(parser, binding_power, "Expected a value for the global variable after =.");
           yp_node_t *read = node;
 
-          yp_node_t *result = yp_node_global_variable_write_create(parser, &node->as.global_variable_read.name, &token, value);
+          yp_token_t name = yp_node_token_unpack(parser, &((yp_global_variable_read_t *) node)->name);
+          yp_node_t *result = yp_node_global_variable_write_create(parser, &name, &token, value);
           yp_node_destroy(parser, read);
           return result;
         }
@@ -2593,8 +2770,8 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
           yp_node_t *value = parse_expression(parser, binding_power, "Expected a value for the local variable after =.");
           yp_node_t *read = node;
 
-          yp_token_t name = node->as.local_variable_read.name;
-          yp_token_list_append(&parser->current_scope->as.scope.locals, &name);
+          yp_token_t name = yp_node_token_unpack(parser, &((yp_local_variable_read_t *) node)->name);
+          scope_local_add(parser, &name);
 
           yp_node_t *result = yp_node_local_variable_write_create(parser, &name, &token, value);
           yp_node_destroy(parser, read);
@@ -2604,17 +2781,18 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
           yp_node_t *value = parse_expression(parser, binding_power, "Expected a value for the instance variable after =.");
           yp_node_t *read = node;
 
-          yp_node_t *result = yp_node_instance_variable_write_create(parser, &node->as.instance_variable_read.name, &token, value);
+          yp_token_t name = yp_node_token_unpack(parser, &((yp_instance_variable_read_t *) node)->name);
+          yp_node_t *result = yp_node_instance_variable_write_create(parser, &name, &token, value);
           yp_node_destroy(parser, read);
           return result;
         }
         case YP_NODE_CALL_NODE: {
-          if (node->as.call_node.receiver == NULL && node->as.call_node.arguments == NULL) {
+          if (((yp_call_node_t *) node)->receiver == NULL && ((yp_call_node_t *) node)->arguments == NULL) {
             yp_node_t *value = parse_expression(parser, binding_power, "Expected a value for the local variable after =.");
             yp_node_t *read = node;
 
-            yp_token_t name = node->as.call_node.message;
-            yp_token_list_append(&parser->current_scope->as.scope.locals, &name);
+            yp_token_t name = yp_node_token_unpack(parser, &((yp_call_node_t *) node)->message);
+            scope_local_add(parser, &name);
 
             yp_node_t *result = yp_node_local_variable_write_create(parser, &name, &token, value);
             yp_node_destroy(parser, read);
@@ -2631,17 +2809,20 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
 
           yp_node_t *value = parse_expression(parser, binding_power, "Expected a value for the call after =.");
           yp_node_t *arguments = yp_node_arguments_node_create(parser);
-          yp_node_list_append(parser, arguments, &arguments->as.arguments_node.arguments, value);
+          yp_node_list_append(parser, arguments, &((yp_arguments_node_t *) arguments)->arguments, value);
 
           yp_token_t rparen;
           not_provided(&rparen, parser->previous.end);
 
-          int length = node->location.end - node->location.start;
-          yp_string_t *name = yp_string_alloc();
-          yp_string_owned_init(name, malloc(length + 1), length + 1);
-          sprintf(name->as.owned.source, "%.*s=", length, parser->start + node->location.start);
+          size_t length = node->location.end - node->location.start;
+          char *source = malloc(length + 1);
+          memcpy(source, parser->start + node->location.start, length);
+          source[length] = '=';
+
+          yp_string_t name;
+          yp_string_owned_init(&name, source, length + 1);
 
-          return yp_node_call_node_create(parser, node, &call_operator, &token, &lparen, arguments, &rparen, name);
+          return yp_node_call_node_create(parser, node, &call_operator, &token, &lparen, arguments, &rparen, &name);
         }
       }
     }
@@ -2703,10 +2884,10 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
 
       yp_node_t *arguments = yp_node_arguments_node_create(parser);
       yp_node_t *argument = parse_expression(parser, binding_power, "Expected a value after the operator.");
-      yp_node_list_append(parser, arguments, &arguments->as.arguments_node.arguments, argument);
+      yp_node_list_append(parser, arguments, &((yp_arguments_node_t *) arguments)->arguments, argument);
 
-      yp_string_t *name = yp_string_alloc();
-      yp_string_shared_init(name, token.start, token.end);
+      yp_string_t name;
+      yp_string_shared_init(&name, token.start, token.end);
 
       yp_token_t lparen;
       not_provided(&lparen, token.end);
@@ -2714,7 +2895,7 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
       yp_token_t rparen;
       not_provided(&rparen, token.end);
 
-      return yp_node_call_node_create(parser, node, &call_operator, &token, &lparen, arguments, &rparen, name);
+      return yp_node_call_node_create(parser, node, &call_operator, &token, &lparen, arguments, &rparen, &name);
     }
     case YP_TOKEN_DOT: {
       yp_token_t call_operator = parser->previous;
@@ -2761,7 +2942,7 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
     }
     case YP_TOKEN_KEYWORD_IF: {
       yp_node_t *statements = yp_node_statements_create(parser);
-      yp_node_list_append(parser, statements, &statements->as.statements.body, node);
+      yp_node_list_append(parser, statements, &((yp_statements_t *) statements)->body, node);
 
       yp_node_t *predicate = parse_expression(parser, binding_power, "Expected a predicate after 'if'");
       yp_token_t end_keyword;
@@ -2771,7 +2952,7 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
     }
     case YP_TOKEN_KEYWORD_UNLESS: {
       yp_node_t *statements = yp_node_statements_create(parser);
-      yp_node_list_append(parser, statements, &statements->as.statements.body, node);
+      yp_node_list_append(parser, statements, &((yp_statements_t *) statements)->body, node);
 
       yp_node_t *predicate = parse_expression(parser, binding_power, "Expected a predicate after 'unless'");
       yp_token_t end_keyword;
@@ -2781,14 +2962,14 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
     }
     case YP_TOKEN_KEYWORD_UNTIL: {
       yp_node_t *statements = yp_node_statements_create(parser);
-      yp_node_list_append(parser, statements, &statements->as.statements.body, node);
+      yp_node_list_append(parser, statements, &((yp_statements_t *) statements)->body, node);
 
       yp_node_t *predicate = parse_expression(parser, binding_power, "Expected a predicate after 'until'");
       return yp_node_until_node_create(parser, &token, predicate, statements);
     }
     case YP_TOKEN_KEYWORD_WHILE: {
       yp_node_t *statements = yp_node_statements_create(parser);
-      yp_node_list_append(parser, statements, &statements->as.statements.body, node);
+      yp_node_list_append(parser, statements, &((yp_statements_t *) statements)->body, node);
 
       yp_node_t *predicate = parse_expression(parser, binding_power, "Expected a predicate after 'while'");
       return yp_node_while_node_create(parser, &token, predicate, statements);
@@ -2826,8 +3007,8 @@ parse_expression_infix(yp_parser_t *parser, yp_node_t *node, binding_power_t bin
         }
         case YP_TOKEN_IDENTIFIER: {
           yp_node_t *call = parse_expression(parser, binding_power, "Expected a value after '::'");
-          call->as.call_node.call_operator = delimiter;
-          call->as.call_node.receiver = node;
+          ((yp_call_node_t *) call)->call_operator = yp_node_token_pack(parser, &delimiter);
+          ((yp_call_node_t *) call)->receiver = node;
           return call;
         }
         default: {
@@ -2880,11 +3061,615 @@ parse_program(yp_parser_t *parser) {
   parser_lex(parser);
 
   yp_node_t *scope = yp_node_scope_create(parser);
-  parser->current_scope = scope;
+  scope_push(parser, scope);
 
   return yp_node_program_create(parser, scope, parse_statements(parser, YP_CONTEXT_MAIN));
 }
 
+/******************************************************************************/
+/* Incremental parsing                                                        */
+/******************************************************************************/
+
+// The deepest level of nested bodies that yp_reparse will descend into when it
+// is looking for the smallest body that contains an edit.
+#define YP_REPARSE_MAX_DEPTH 16
+
+// Over a chain of reparses, the arena can grow to this many times the memory
+// that the last full parse took before yp_reparse parses from scratch again.
+#define YP_REPARSE_ARENA_GROWTH 2
+
+// This is one of the bodies of statements on the path from the root of a
+// previous tree down to an edit.
+typedef struct {
+  yp_node_t **scope;      // the field of the owning node that holds its Scope
+  yp_node_t **statements; // the field of the owning node that holds its Statements
+  yp_context_t context;   // the context that the statements are parsed in
+  size_t closing;         // the index of the checkpoint where the body finished
+} yp_reparse_level_t;
+
+// This is the state that is used to tell when a reparse has caught back up with
+// the previous parse.
+struct yp_reparse {
+  const yp_parser_t *previous;   // the parser that produced the previous tree
+  const yp_edit_t *edit;         // the edit that was made to the source
+  int64_t delta;                 // the difference in length between the two sources
+  const yp_node_t *statements;   // the Statements node in the previous tree being replaced
+  const yp_token_list_t *locals; // the locals of the scope that the statements belong to
+  size_t *distinct;              // the number of distinct names in the first n locals
+  size_t caught_up;              // the index of the checkpoint that was caught up with
+};
+
+// Find the index of the first checkpoint of the previous parse whose current
+// token starts at or after the given offset. Checkpoints are recorded in the
+// order that the parser reaches them, so they're sorted by this offset.
+static size_t
+reparse_checkpoint_search(const yp_parser_t *previous, uint32_t offset) {
+  size_t low = 0;
+  size_t high = previous->checkpoints.size;
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+
+    if (previous->checkpoints.values[mid].current_start < offset) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+// Find the last checkpoint in the given body where parsing can resume, which is
+// the last one where the current token ends before the edit. Returns SIZE_MAX
+// if there isn't one.
+static size_t
+reparse_resume_search(const yp_parser_t *previous, const yp_node_t *statements, const yp_edit_t *edit) {
+  size_t index = reparse_checkpoint_search(previous, edit->start);
+
+  while (index > 0) {
+    const yp_checkpoint_t *checkpoint = &previous->checkpoints.values[--index];
+    if (checkpoint->statements != statements || checkpoint->closing) continue;
+
+    if (checkpoint->current_end < edit->start) return index;
+    if (checkpoint->index == 0) break;
+  }
+
+  return SIZE_MAX;
+}
+
+// Find the checkpoint where the given body finished, as long as it comes after
+// the edit. The body is owned by a node that ends at the given offset, so the
+// search can stop there. Returns SIZE_MAX if there isn't one.
+static size_t
+reparse_closing_search(const yp_parser_t *previous, const yp_node_t *statements, const yp_edit_t *edit, uint32_t end) {
+  for (size_t index = reparse_checkpoint_search(previous, edit->old_end); index < previous->checkpoints.size; index++) {
+    const yp_checkpoint_t *checkpoint = &previous->checkpoints.values[index];
+    if (checkpoint->current_start > end) break;
+
+    if (checkpoint->statements == statements && checkpoint->closing) {
+      return checkpoint->previous_start > edit->old_end ? index : SIZE_MAX;
+    }
+  }
+
+  return SIZE_MAX;
+}
+
+// Find the path of bodies from the root of the previous tree down to the
+// deepest class, module, singleton class, or method body that contains the
+// edit. Returns the number of levels in the path.
+static size_t
+reparse_levels(const yp_parser_t *previous, yp_node_t *tree, const yp_edit_t *edit, yp_reparse_level_t *levels) {
+  levels[0] = (yp_reparse_level_t) {
+    .scope = &((yp_program_t *) tree)->scope,
+    .statements = &((yp_program_t *) tree)->statements,
+    .context = YP_CONTEXT_MAIN,
+    .closing = SIZE_MAX
+  };
+
+  size_t depth = 1;
+  while (depth < YP_REPARSE_MAX_DEPTH) {
+    yp_node_list_t *body = &((yp_statements_t *) *levels[depth - 1].statements)->body;
+
+    // Find the last statement that starts before the edit.
+    size_t low = 0;
+    size_t high = body->size;
+
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+
+      if (body->nodes[mid]->location.start <= edit->start) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    if (low == 0) break;
+    yp_node_t *node = body->nodes[low - 1];
+    yp_reparse_level_t level;
+
+    switch (node->type) {
+      case YP_NODE_CLASS_NODE:
+        level = (yp_reparse_level_t) { .scope = &((yp_class_node_t *) node)->scope, .statements = &((yp_class_node_t *) node)->statements, .context = YP_CONTEXT_CLASS };
+        break;
+      case YP_NODE_DEF_NODE:
+        level = (yp_reparse_level_t) { .scope = &((yp_def_node_t *) node)->scope, .statements = &((yp_def_node_t *) node)->statements, .context = YP_CONTEXT_DEF };
+        break;
+      case YP_NODE_MODULE_NODE:
+        level = (yp_reparse_level_t) { .scope = &((yp_module_node_t *) node)->scope, .statements = &((yp_module_node_t *) node)->statements, .context = YP_CONTEXT_MODULE };
+        break;
+      case YP_NODE_S_CLASS_NODE:
+        level = (yp_reparse_level_t) { .scope = &((yp_s_class_node_t *) node)->scope, .statements = &((yp_s_class_node_t *) node)->statements, .context = YP_CONTEXT_SCLASS };
+        break;
+      default:
+        return depth;
+    }
+
+    level.closing = reparse_closing_search(previous, *level.statements, edit, node->location.end);
+    if (level.closing == SIZE_MAX) break;
+
+    levels[depth++] = level;
+  }
+
+  return depth;
+}
+
+// Return the number of locals in the list that were added before the parser
+// reached the given offset. Locals are added as the parser moves forward, so
+// these are always at the front of the list.
+static size_t
+reparse_locals_before(const yp_token_list_t *locals, uint32_t offset) {
+  size_t low = 0;
+  size_t high = locals->size;
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+
+    if (locals->tokens[mid].start < offset) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+// Count the distinct names in each prefix of the given scope's list of locals,
+// so that the set of locals at a checkpoint can be compared quickly. The names
+// are read out of the previous source, so the scope is pushed onto a parser that
+// only knows about that source rather than onto the previous parser itself.
+static size_t *
+reparse_distinct_locals(const yp_parser_t *previous, yp_node_t *scope) {
+  size_t size = ((yp_scope_t *) scope)->locals.size;
+  size_t *distinct = malloc((size + 1) * sizeof(size_t));
+  distinct[0] = 0;
+
+  yp_parser_t names = { .start = previous->start, .end = previous->end, .current_scope = NULL };
+  scope_push(&names, scope);
+
+  for (size_t index = 0; index < size; index++) {
+    scope_local_insert(&names, index);
+    distinct[index + 1] = names.current_scope->size;
+  }
+
+  scope_pop(&names);
+  return distinct;
+}
+
+// Check whether the parser is in the same state that the previous parser was in
+// at the given checkpoint, once the edit is accounted for. If it is, then
+// everything the previous parser did from there on would be done again.
+static bool
+reparse_matches(yp_parser_t *parser, yp_reparse_t *reparse, size_t index) {
+  const yp_parser_t *previous = reparse->previous;
+  const yp_checkpoint_t *checkpoint = &previous->checkpoints.values[index];
+  int64_t delta = reparse->delta;
+
+  if (
+    parser->recovering != checkpoint->recovering ||
+    parser->previous.type != checkpoint->previous_type ||
+    parser->current.type != checkpoint->current_type ||
+    parser->previous.start - parser->start <= reparse->edit->new_end ||
+    parser->previous.start - parser->start != checkpoint->previous_start + delta ||
+    parser->previous.end - parser->start != checkpoint->previous_end + delta ||
+    parser->current.start - parser->start != checkpoint->current_start + delta ||
+    parser->current.end - parser->start != checkpoint->current_end + delta ||
+    memcmp(&parser->encoding, &checkpoint->encoding, sizeof(yp_encoding_t)) != 0
+  ) {
+    return false;
+  }
+
+  // The locals decide whether identifiers are parsed as local variable reads,
+  // so the set of them has to be the same as well.
+  size_t count = reparse_locals_before(reparse->locals, checkpoint->current_start);
+  if (parser->current_scope->size != reparse->distinct[count]) return false;
+
+  for (size_t local_index = 0; local_index < count; local_index++) {
+    const yp_node_token_t *local = &reparse->locals->tokens[local_index];
+    yp_token_t token = { .type = local->type, .start = previous->start + local->start, .end = previous->start + local->end };
+    if (!scope_local_includes(parser, &token)) return false;
+  }
+
+  return true;
+}
+
+// Called at the top of each iteration of the loop over the statements that are
+// being reparsed. If the parser has moved past the edit and is in the same
+// state as it was at the top of an iteration in the previous parse, then the
+// rest of the previous statements can be reused.
+static bool
+reparse_caught_up(yp_parser_t *parser, yp_reparse_t *reparse) {
+  if ((uint32_t) (parser->previous.start - parser->start) <= reparse->edit->new_end) return false;
+
+  const yp_parser_t *previous = reparse->previous;
+  uint32_t offset = (uint32_t) ((parser->current.start - parser->start) - reparse->delta);
+
+  for (size_t index = reparse_checkpoint_search(previous, offset); index < previous->checkpoints.size; index++) {
+    const yp_checkpoint_t *checkpoint = &previous->checkpoints.values[index];
+    if (checkpoint->current_start != offset) break;
+
+    if (checkpoint->statements == reparse->statements && !checkpoint->closing) {
+      if (!reparse_matches(parser, reparse, index)) return false;
+
+      reparse->caught_up = index;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Move an offset after the edit into the new source. Like the locations of
+// nodes, an offset of 0 hasn't been filled in, so it stays where it is.
+static inline uint32_t
+reparse_shift(uint32_t offset, int64_t delta) {
+  return offset == 0 ? 0 : (uint32_t) (offset + delta);
+}
+
+// The source before the edit is the same in both parses, so the starts of the
+// lines in it are copied over instead of being found again.
+static void
+reparse_newlines_prefix(yp_parser_t *parser, const yp_parser_t *previous, const yp_edit_t *edit) {
+  const yp_newline_list_t *previous_list = &previous->newline_list;
+  yp_newline_list_t *list = &parser->newline_list;
+
+  list->size = 0;
+  for (size_t index = 0; index < previous_list->size && previous_list->offsets[index] <= edit->start; index++) {
+    yp_newline_list_append(list, previous_list->offsets[index]);
+  }
+
+  list->scanned = edit->start;
+}
+
+// Finish the list of the starts of the lines after a reparse. If the parse
+// caught up with the previous one, the source after the edit is the same as
+// the previous source after the edit, so those lines are moved over from the
+// previous parse. Otherwise whatever the lexer didn't get to is scanned.
+static void
+reparse_newlines_suffix(yp_parser_t *parser, const yp_parser_t *previous, const yp_edit_t *edit, bool caught_up) {
+  yp_newline_list_t *list = &parser->newline_list;
+  size_t size = (size_t) (parser->end - parser->start);
+
+  if (!caught_up) {
+    yp_newline_list_scan(list, parser->start, size);
+    return;
+  }
+
+  yp_newline_list_scan(list, parser->start, edit->new_end);
+  while (list->size > 1 && list->offsets[list->size - 1] > edit->new_end) list->size--;
+
+  const yp_newline_list_t *previous_list = &previous->newline_list;
+  int64_t delta = (int64_t) edit->new_end - (int64_t) edit->old_end;
+
+  for (size_t index = 0; index < previous_list->size; index++) {
+    if (previous_list->offsets[index] > edit->old_end) {
+      yp_newline_list_append(list, (uint32_t) (previous_list->offsets[index] + delta));
+    }
+  }
+
+  list->scanned = size;
+}
+
+// Free a parser and initialize it again for the same source so that another
+// attempt can be made.
+static void
+reparse_reset(yp_parser_t *parser) {
+  yp_encoding_decode_callback_t callback = parser->encoding_decode_callback;
+  bool reparseable = parser->reparseable;
+  bool cancelled = __atomic_load_n(&parser->cancelled, __ATOMIC_RELAXED);
+  const char *source = parser->start;
+  size_t size = (size_t) (parser->end - parser->start);
+
+  yp_parser_free(parser);
+  yp_parser_init(parser, source, size);
+  parser->encoding_decode_callback = callback;
+  parser->reparseable = reparseable;
+  if (cancelled) yp_parser_cancel(parser);
+}
+
+// Attempt to reparse the body at the given depth of the path to the edit. This
+// resumes the previous parse at the last statement before the edit and parses
+// until it catches up with the previous parse again. The statements before and
+// after that are moved into the new tree. Returns the new tree, or NULL if the
+// parse didn't catch up before the end of the body, in which case the parser
+// needs to be reset before it's used again.
+static yp_node_t *
+reparse_level(yp_parser_t *parser, yp_parser_t *previous, yp_node_t *tree, const yp_edit_t *edit, const yp_reparse_level_t *levels, size_t depth) {
+  const yp_reparse_level_t *level = &levels[depth];
+  yp_node_t *previous_statements = *level->statements;
+  yp_node_t *previous_scope = *level->scope;
+  yp_node_list_t *previous_body = &((yp_statements_t *) previous_statements)->body;
+  yp_token_list_t *previous_locals = &((yp_scope_t *) previous_scope)->locals;
+
+  size_t resume = reparse_resume_search(previous, previous_statements, edit);
+  if (resume == SIZE_MAX) return NULL;
+
+  yp_checkpoint_t checkpoint = previous->checkpoints.values[resume];
+
+  // Put the parser back into the state that it was in at the checkpoint. The
+  // contexts are all of the bodies on the path, the locals are the ones that
+  // were found before the checkpoint, and the current token is lexed again
+  // from the end of the previous one.
+  for (size_t index = 0; index <= depth; index++) {
+    context_push(parser, levels[index].context);
+  }
+
+  yp_node_t *scope = yp_node_scope_create(parser);
+  scope_push(parser, scope);
+
+  size_t prefix_locals = reparse_locals_before(previous_locals, checkpoint.current_start);
+  for (size_t index = 0; index < prefix_locals; index++) {
+    yp_token_t local = yp_node_token_unpack(parser, &previous_locals->tokens[index]);
+    scope_local_add(parser, &local);
+  }
+
+  parser->encoding = checkpoint.encoding;
+  reparse_newlines_prefix(parser, previous, edit);
+
+  parser->current = (yp_token_t) {
+    .type = checkpoint.previous_type,
+    .start = parser->start + checkpoint.previous_start,
+    .end = parser->start + checkpoint.previous_end
+  };
+  parser_lex(parser);
+
+  // The lexer can look past the end of a token to decide what it is, so the
+  // edit could still have changed the current token.
+  if (
+    parser->current.type != checkpoint.current_type ||
+    parser->current.start - parser->start != checkpoint.current_start ||
+    parser->current.end - parser->start != checkpoint.current_end
+  ) {
+    scope_pop(parser);
+    yp_node_destroy(parser, scope);
+
+    for (size_t index = 0; index <= depth; index++) {
+      context_pop(parser);
+    }
+
+    return NULL;
+  }
+
+  // Any errors or comments that were found while lexing the current token are
+  // already in the previous parser's lists.
+  yp_error_list_free(&parser->error_list);
+  yp_list_init(&parser->error_list);
+  yp_list_free(&parser->comment_list);
+  yp_list_init(&parser->comment_list);
+
+  yp_node_t *statements = yp_node_statements_create(parser);
+  yp_node_list_t *body = &((yp_statements_t *) statements)->body;
+
+  for (size_t index = 0; index < checkpoint.index; index++) {
+    yp_node_list_append(parser, statements, body, previous_body->nodes[index]);
+  }
+
+  int64_t delta = (int64_t) edit->new_end - (int64_t) edit->old_end;
+  yp_reparse_t reparse = {
+    .previous = previous,
+    .edit = edit,
+    .delta = delta,
+    .statements = previous_statements,
+    .locals = previous_locals,
+    .distinct = reparse_distinct_locals(previous, previous_scope),
+    .caught_up = SIZE_MAX
+  };
+
+  parse_statements_body(parser, level->context, statements, &reparse);
+
+  // A nested body has to catch up by the time it finishes at the latest, since
+  // whatever comes after it wasn't parsed again. The program can parse all the
+  // way to the end of the source instead.
+  if (reparse.caught_up == SIZE_MAX && depth > 0 && reparse_matches(parser, &reparse, level->closing)) {
+    reparse.caught_up = level->closing;
+  }
+
+  free(reparse.distinct);
+  scope_pop(parser);
+
+  for (size_t index = 0; index <= depth; index++) {
+    context_pop(parser);
+  }
+
+  if (reparse.caught_up == SIZE_MAX && depth > 0) {
+    for (size_t index = checkpoint.index; index < body->size; index++) {
+      yp_node_destroy(parser, body->nodes[index]);
+    }
+
+    free(body->nodes);
+    yp_node_destroy(parser, scope);
+    return NULL;
+  }
+
+  const yp_checkpoint_t *caught_up = reparse.caught_up == SIZE_MAX ? NULL : &previous->checkpoints.values[reparse.caught_up];
+  size_t suffix = caught_up == NULL ? previous_body->size : caught_up->index;
+
+  yp_node_shift_t shift = {
+    .old_end = edit->old_end,
+    .delta = delta,
+    .previous_source = previous->start,
+    .previous_end = previous->end,
+    .source = parser->start,
+    .skip = { previous_statements, previous_scope }
+  };
+
+  // Build the new list of statements out of the ones before the checkpoint,
+  // the ones that were just parsed, and the ones after the point where the
+  // parse caught up. Everything that's reused has to be moved into the new
+  // source.
+  for (size_t index = 0; index < checkpoint.index; index++) {
+    yp_node_shift(body->nodes[index], &shift);
+  }
+
+  for (size_t index = checkpoint.index; index < suffix; index++) {
+    yp_node_destroy(previous, previous_body->nodes[index]);
+  }
+
+  size_t region_end = body->size;
+
+  for (size_t index = suffix; index < previous_body->size; index++) {
+    yp_node_shift(previous_body->nodes[index], &shift);
+    yp_node_list_append(parser, statements, body, previous_body->nodes[index]);
+  }
+
+  free(previous_body->nodes);
+  *previous_body = (yp_node_list_t) { .nodes = NULL, .size = 0, .capacity = 0 };
+
+  if (caught_up != NULL) {
+    yp_token_list_t *locals = &((yp_scope_t *) scope)->locals;
+
+    for (size_t index = reparse_locals_before(previous_locals, caught_up->current_start); index < previous_locals->size; index++) {
+      yp_node_token_t *local = &previous_locals->tokens[index];
+      yp_token_t token = { .type = local->type, .start = parser->start + local->start + delta, .end = parser->start + local->end + delta };
+      yp_token_list_append(parser, locals, &token);
+    }
+  }
+
+  yp_node_destroy(previous, previous_scope);
+
+  if (depth == 0) {
+    tree = yp_node_program_create(parser, scope, statements);
+  } else {
+    yp_node_shift(tree, &shift);
+    *level->statements = statements;
+    *level->scope = scope;
+  }
+
+  // The errors are kept in the order that they were found, so the ones from
+  // before the checkpoint and after the catch up point can be moved over by
+  // position in the list.
+  yp_list_t errors = parser->error_list;
+  size_t region_errors = errors.size;
+  yp_list_t suffix_errors;
+
+  yp_list_init(&parser->error_list);
+  yp_list_init(&suffix_errors);
+
+  yp_list_node_t *node = previous->error_list.head;
+  yp_list_init(&previous->error_list);
+
+  for (size_t index = 0; node != NULL; index++) {
+    yp_list_node_t *next = node->next;
+    node->next = NULL;
+
+    if (index < checkpoint.errors) {
+      yp_list_append(&parser->error_list, node);
+    } else if (caught_up != NULL && index >= caught_up->errors) {
+      node->start = reparse_shift(node->start, delta);
+      node->end = reparse_shift(node->end, delta);
+      yp_list_append(&suffix_errors, node);
+    } else {
+      yp_list_append(&previous->error_list, node);
+    }
+
+    node = next;
+  }
+
+  yp_list_concat(&parser->error_list, &errors);
+  yp_list_concat(&parser->error_list, &suffix_errors);
+
+  // Comments are found in the order that they appear in the source, so they're
+  // moved over by where they end.
+  yp_list_t comments = parser->comment_list;
+  yp_list_t suffix_comments;
+
+  yp_list_init(&parser->comment_list);
+  yp_list_init(&suffix_comments);
+
+  node = previous->comment_list.head;
+  yp_list_init(&previous->comment_list);
+
+  while (node != NULL) {
+    yp_list_node_t *next = node->next;
+    node->next = NULL;
+
+    if (node->end <= checkpoint.current_start) {
+      yp_list_append(&parser->comment_list, node);
+    } else if (caught_up != NULL && node->end > caught_up->current_start) {
+      node->start = reparse_shift(node->start, delta);
+      node->end = reparse_shift(node->end, delta);
+      yp_list_append(&suffix_comments, node);
+    } else {
+      yp_list_append(&previous->comment_list, node);
+    }
+
+    node = next;
+  }
+
+  yp_list_concat(&parser->comment_list, &comments);
+  yp_list_concat(&parser->comment_list, &suffix_comments);
+  reparse_newlines_suffix(parser, previous, edit, caught_up != NULL);
+
+  // The checkpoints are rebuilt the same way so that the new tree can be
+  // reparsed in turn.
+  size_t prefix_checkpoints = resume;
+  size_t region_checkpoints = parser->checkpoints.size;
+  size_t suffix_checkpoints = caught_up == NULL ? 0 : previous->checkpoints.size - reparse.caught_up;
+  size_t capacity = prefix_checkpoints + region_checkpoints + suffix_checkpoints;
+  yp_checkpoint_t *checkpoints = malloc((capacity == 0 ? 1 : capacity) * sizeof(yp_checkpoint_t));
+
+  for (size_t index = 0; index < prefix_checkpoints; index++) {
+    checkpoints[index] = previous->checkpoints.values[index];
+    if (checkpoints[index].statements == previous_statements) checkpoints[index].statements = statements;
+  }
+
+  for (size_t index = 0; index < region_checkpoints; index++) {
+    checkpoints[prefix_checkpoints + index] = parser->checkpoints.values[index];
+    checkpoints[prefix_checkpoints + index].errors += checkpoint.errors;
+  }
+
+  for (size_t index = 0; index < suffix_checkpoints; index++) {
+    yp_checkpoint_t *value = &checkpoints[prefix_checkpoints + region_checkpoints + index];
+    *value = previous->checkpoints.values[reparse.caught_up + index];
+
+    if (value->statements == previous_statements) {
+      value->statements = statements;
+      value->index = (uint32_t) (value->index - suffix + region_end);
+    }
+
+    value->previous_start = reparse_shift(value->previous_start, delta);
+    value->previous_end = reparse_shift(value->previous_end, delta);
+    value->current_start = reparse_shift(value->current_start, delta);
+    value->current_end = reparse_shift(value->current_end, delta);
+    value->errors = value->errors - caught_up->errors + checkpoint.errors + region_errors;
+  }
+
+  free(parser->checkpoints.values);
+  parser->checkpoints.values = checkpoints;
+  parser->checkpoints.size = capacity;
+  parser->checkpoints.capacity = capacity;
+
+  // If the rest of the previous parse was reused, then so is the encoding that
+  // it finished with.
+  if (caught_up != NULL) parser->encoding = previous->encoding;
+
+  yp_arena_adopt(&parser->arena, &previous->arena);
+  parser->arena_limit = previous->arena_limit;
+  return tree;
+}
+
 /******************************************************************************/
 /* External functions                                                         */
 /******************************************************************************/
@@ -2913,12 +3698,18 @@ yp_parser_init(yp_parser_t *parser, const char *source, size_t size) {
     .current_scope = NULL,
     .current_context = NULL,
     .recovering = false,
+    .reparseable = false,
+    .cancelled = false,
+    .checkpoints = { .values = NULL, .size = 0, .capacity = 0 },
+    .arena_limit = 0,
     .encoding = yp_encoding_utf_8,
     .encoding_decode_callback = undecodeable
   };
 
   yp_list_init(&parser->error_list);
   yp_list_init(&parser->comment_list);
+  yp_newline_list_init(&parser->newline_list);
+  yp_arena_init(&parser->arena);
 }
 
 // Register a callback that will be called when YARP encounters a magic comment
@@ -2931,37 +3722,194 @@ yp_parser_register_encoding_decode_callback(yp_parser_t *parser, yp_encoding_dec
   parser->encoding_decode_callback = callback;
 }
 
-// Free any memory associated with the given parser.
+// Record checkpoints while parsing so that the tree can be reparsed.
+__attribute__((__visibility__("default"))) extern void
+yp_parser_enable_reparse(yp_parser_t *parser) {
+  parser->reparseable = true;
+}
+
+// Stop lexing or parsing at the next token. This can be called from another
+// thread or a signal handler while the parser is running.
+__attribute__((__visibility__("default"))) extern void
+yp_parser_cancel(yp_parser_t *parser) {
+  __atomic_store_n(&parser->cancelled, true, __ATOMIC_RELAXED);
+}
+
+// Free any memory associated with the given parser. This includes the memory
+// for every node that was allocated while parsing, so any tree returned from
+// yp_parse must not be used after this is called.
 __attribute__((__visibility__("default"))) extern void
 yp_parser_free(yp_parser_t *parser) {
   yp_error_list_free(&parser->error_list);
   yp_list_free(&parser->comment_list);
+  yp_newline_list_free(&parser->newline_list);
+
+  while (parser->current_scope != NULL) {
+    scope_pop(parser);
+  }
+
+  free(parser->checkpoints.values);
+  yp_arena_free(&parser->arena);
 }
 
 // Get the next token type and set its value on the current pointer.
 __attribute__((__visibility__("default"))) extern void
 yp_lex_token(yp_parser_t *parser) {
   parser->previous = parser->current;
+  if (parser_lex_cancelled(parser)) return;
   parser->current.type = lex_token_type(parser);
+  parser_lex_newlines(parser);
 }
 
 // Parse the Ruby source associated with the given parser and return the tree.
 __attribute__((__visibility__("default"))) extern yp_node_t *
 yp_parse(yp_parser_t *parser) {
-  return parse_program(parser);
+  yp_node_t *node = parse_program(parser);
+
+  // Make sure the list of lines is complete no matter where the lexer stopped.
+  yp_newline_list_scan(&parser->newline_list, parser->start, (size_t) (parser->end - parser->start));
+  parser->arena_limit = YP_REPARSE_ARENA_GROWTH * parser->arena.size;
+  return node;
 }
 
+// Parse the Ruby source associated with the given parser, which is the source
+// that the previous parser was given with the given edit applied to it. Parts
+// of the previous tree that the edit didn't affect are moved into the new tree
+// instead of being parsed again.
+__attribute__((__visibility__("default"))) extern yp_node_t *
+yp_reparse(yp_parser_t *parser, yp_parser_t *previous, yp_node_t *tree, const yp_edit_t *edit) {
+  size_t size = (size_t) (parser->end - parser->start);
+  size_t previous_size = (size_t) (previous->end - previous->start);
+  parser->reparseable = previous->reparseable;
+
+  if (
+    previous->reparseable &&
+    previous->arena.size <= previous->arena_limit &&
+    size <= UINT32_MAX &&
+    edit->start <= edit->old_end &&
+    edit->start <= edit->new_end &&
+    edit->old_end <= previous_size &&
+    edit->new_end <= size &&
+    size - edit->new_end == previous_size - edit->old_end
+  ) {
+    yp_reparse_level_t levels[YP_REPARSE_MAX_DEPTH];
+    size_t depth = reparse_levels(previous, tree, edit, levels);
+
+    // Try the innermost body first, since it's the least amount of work. If it
+    // doesn't work out, then try the body around it.
+    while (depth-- > 0) {
+      yp_node_t *result = reparse_level(parser, previous, tree, edit, levels, depth);
+      if (result != NULL) return result;
+
+      reparse_reset(parser);
+    }
+  }
+
+  yp_node_destroy(previous, tree);
+  return yp_parse(parser);
+}
+
+// Serialize the AST represented by the given node to the given buffer.
 __attribute__((__visibility__("default"))) extern void
 yp_serialize(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer) {
+  yp_serialize_with_flags(parser, node, buffer, 0);
+}
+
+// Write the header of a serialized tree, which holds the version, the flags,
+// and the optional sections that the flags select.
+static void
+serialize_header(yp_parser_t *parser, yp_buffer_t *buffer, uint8_t flags) {
   yp_buffer_append_str(buffer, "YARP", 4);
   yp_buffer_append_u8(buffer, YP_VERSION_MAJOR);
   yp_buffer_append_u8(buffer, YP_VERSION_MINOR);
   yp_buffer_append_u8(buffer, YP_VERSION_PATCH);
+  yp_buffer_append_u8(buffer, flags);
+
+  // The starts of the lines are written as the length of each line, so that
+  // most of them fit in a single byte.
+  if (flags & YP_SERIALIZE_NEWLINES) {
+    const yp_newline_list_t *newline_list = &parser->newline_list;
+    yp_buffer_append_varint(buffer, newline_list->size);
 
-  yp_serialize_node(parser, node, buffer);
+    uint32_t previous = 0;
+    for (size_t index = 0; index < newline_list->size; index++) {
+      yp_buffer_append_varint(buffer, newline_list->offsets[index] - previous);
+      previous = newline_list->offsets[index];
+    }
+  }
+}
+
+// Serialize the AST represented by the given node to the given buffer, with
+// the optional sections selected by the given yp_serialize_flags_t values.
+__attribute__((__visibility__("default"))) extern void
+yp_serialize_with_flags(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer, uint8_t flags) {
+  size_t start = buffer->length;
+  serialize_header(parser, buffer, flags);
+  yp_serialize_node(parser, node, buffer, start);
   yp_buffer_append_str(buffer, "\0", 1);
 }
 
+// Serialize the AST represented by the given node to the given sink, with the
+// given yp_serialize_flags_t values.
+__attribute__((__visibility__("default"))) extern bool
+yp_serialize_to_sink(yp_parser_t *parser, yp_node_t *node, yp_serialize_sink_t *sink, uint8_t flags) {
+  yp_buffer_t buffer;
+  yp_buffer_init(&buffer);
+
+  serialize_header(parser, &buffer, flags);
+  bool result = yp_serialize_node_to_sink(parser, node, &buffer, sink);
+
+  // Whatever is left over is less than a full chunk, so it goes out as the
+  // last one.
+  yp_buffer_append_str(&buffer, "\0", 1);
+  result = result && !buffer.failed && sink->write(sink, buffer.value, buffer.length);
+
+  yp_buffer_free(&buffer);
+  return result;
+}
+
+// Write a chunk to the file descriptor held by the sink, picking up after
+// partial writes and interrupted calls.
+static bool
+serialize_sink_fd_write(yp_serialize_sink_t *sink, const char *bytes, size_t length) {
+  int fd = *((int *) sink->data);
+
+  while (length > 0) {
+    ssize_t written = write(fd, bytes, length);
+
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+
+    bytes += written;
+    length -= (size_t) written;
+  }
+
+  return true;
+}
+
+// Serialize the AST represented by the given node to the given file
+// descriptor.
+__attribute__((__visibility__("default"))) extern bool
+yp_serialize_to_fd(yp_parser_t *parser, yp_node_t *node, int fd, uint8_t flags) {
+  yp_serialize_sink_t sink = { .write = serialize_sink_fd_write, .data = &fd, .chunk_size = 0 };
+  return yp_serialize_to_sink(parser, node, &sink, flags);
+}
+
+// Write a chunk to the file held by the sink.
+static bool
+serialize_sink_file_write(yp_serialize_sink_t *sink, const char *bytes, size_t length) {
+  return fwrite(bytes, 1, length, (FILE *) sink->data) == length;
+}
+
+// Serialize the AST represented by the given node to the given file.
+__attribute__((__visibility__("default"))) extern bool
+yp_serialize_to_file(yp_parser_t *parser, yp_node_t *node, FILE *file, uint8_t flags) {
+  yp_serialize_sink_t sink = { .write = serialize_sink_file_write, .data = file, .chunk_size = 0 };
+  return yp_serialize_to_sink(parser, node, &sink, flags);
+}
+
 // Parse and serialize the AST represented by the given source to the given
 // buffer.
 __attribute__((__visibility__("default"))) extern void
@@ -9,6 +9,9 @@
 #include <string.h>
 
 #include "util/yp_buffer.h"
+#include "util/yp_constant_pool.h"
+#include "util/yp_strpbrk.h"
+#include "util/yp_strspn.h"
 #include "ast.h"
 #include "error.h"
 #include "pack.h"
@@ -17,11 +20,30 @@
 #include "node.h"
 
 #define YP_VERSION_MAJOR 0
-#define YP_VERSION_MINOR 2
+#define YP_VERSION_MINOR 5
 #define YP_VERSION_PATCH 0
 
 void
-yp_serialize_node(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer);
+yp_serialize_node(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer, size_t start);
+
+// The number of bytes that are passed to a sink at a time, unless the sink
+// asks for a different size.
+#define YP_SERIALIZE_CHUNK_SIZE 32768
+
+// A sink that a serialized tree is written to a chunk at a time by
+// yp_serialize_to_sink. Every chunk is chunk_size bytes long (or
+// YP_SERIALIZE_CHUNK_SIZE if that's 0) except for the last one, which can be
+// shorter.
+typedef struct yp_serialize_sink {
+  // Write the given bytes, returning false if they couldn't be written, in
+  // which case nothing else is written to the sink.
+  bool (*write)(struct yp_serialize_sink *sink, const char *bytes, size_t length);
+  void *data;
+  size_t chunk_size;
+} yp_serialize_sink_t;
+
+bool
+yp_serialize_node_to_sink(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer, yp_serialize_sink_t *sink);
 
 void
 yp_print_node(yp_parser_t *parser, yp_node_t *node);
@@ -42,7 +64,23 @@ yp_parser_init(yp_parser_t *parser, const char *source, size_t size);
 __attribute__((__visibility__("default"))) extern void
 yp_parser_register_encoding_decode_callback(yp_parser_t *parser, yp_encoding_decode_callback_t callback);
 
-// Free any memory associated with the given parser.
+// Record checkpoints while parsing so that the tree that yp_parse returns can
+// be passed to yp_reparse. This holds on to some state for every statement in
+// the bodies that can be reparsed, so it's off unless it's asked for. It has to
+// be called before parsing.
+__attribute__((__visibility__("default"))) extern void
+yp_parser_enable_reparse(yp_parser_t *parser);
+
+// Make the parser stop at the next token, as though the source ended there, so
+// that a long lex or parse can be abandoned. This can be called from another
+// thread or a signal handler while the parser is running. The tree that comes
+// out is incomplete, so it should only be destroyed.
+__attribute__((__visibility__("default"))) extern void
+yp_parser_cancel(yp_parser_t *parser);
+
+// Free any memory associated with the given parser. This includes the memory
+// for every node that was allocated while parsing, so any tree returned from
+// yp_parse must not be used after this is called.
 __attribute__((__visibility__("default"))) extern void
 yp_parser_free(yp_parser_t *parser);
 
@@ -54,7 +92,27 @@ yp_lex_token(yp_parser_t *parser);
 __attribute__((__visibility__("default"))) extern yp_node_t *
 yp_parse(yp_parser_t *parser);
 
-// Deallocate a node and all of its children.
+// Parse the source associated with the given parser after an edit was made to
+// the source of a previous parse, reusing the parts of the previous tree that
+// the edit didn't affect. The parser must have been initialized with the new
+// source, and the edit describes how it differs from the previous source. Only
+// a tree from a parser that had yp_parser_enable_reparse called on it can be
+// reused, and otherwise this falls back to a full parse. The new parser records
+// checkpoints if the previous one did, so that the new tree can be reparsed in
+// turn.
+//
+// The previous tree and parser are consumed. The reused nodes, errors, and
+// comments are moved out of the previous parser, so the tree must not be used
+// or destroyed afterward and the only thing that can still be done with the
+// previous parser is to free it. Since the memory for the reused nodes is moved
+// over too, the memory for the nodes that edits replaced is held on to as well.
+// Once that reaches twice what the last full parse took, this parses from
+// scratch instead, so the memory stays bounded over any number of edits.
+__attribute__((__visibility__("default"))) extern yp_node_t *
+yp_reparse(yp_parser_t *parser, yp_parser_t *previous, yp_node_t *tree, const yp_edit_t *edit);
+
+// Deallocate the memory owned by a node and all of its children. The nodes
+// themselves live in the parser's arena and are released by yp_parser_free.
 __attribute__((__visibility__("default"))) extern void
 yp_node_destroy(yp_parser_t *parser, struct yp_node *node);
 
@@ -66,6 +124,35 @@ yp_prettyprint(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer);
 __attribute__((__visibility__("default"))) extern void
 yp_serialize(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer);
 
+// The flags that can be given to yp_serialize_with_flags. They're written into
+// the header so that loaders know which optional sections follow.
+typedef enum {
+  YP_SERIALIZE_NEWLINES = 1 << 0 // write the offsets of the starts of the lines into the header
+} yp_serialize_flags_t;
+
+// Serialize the AST represented by the given node to the given buffer, with
+// the optional sections selected by the given yp_serialize_flags_t values.
+__attribute__((__visibility__("default"))) extern void
+yp_serialize_with_flags(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer, uint8_t flags);
+
+// Serialize the AST represented by the given node to the given sink, with the
+// given yp_serialize_flags_t values. Only one chunk of the output is held in
+// memory at a time, along with a table of the lengths of the nodes. Returns
+// false if the sink failed to write a chunk.
+__attribute__((__visibility__("default"))) extern bool
+yp_serialize_to_sink(yp_parser_t *parser, yp_node_t *node, yp_serialize_sink_t *sink, uint8_t flags);
+
+// Serialize the AST represented by the given node to the given file
+// descriptor, as yp_serialize_to_sink does. Returns false if writing failed,
+// in which case errno is set.
+__attribute__((__visibility__("default"))) extern bool
+yp_serialize_to_fd(yp_parser_t *parser, yp_node_t *node, int fd, uint8_t flags);
+
+// Serialize the AST represented by the given node to the given file, as
+// yp_serialize_to_sink does. Returns false if writing failed.
+__attribute__((__visibility__("default"))) extern bool
+yp_serialize_to_file(yp_parser_t *parser, yp_node_t *node, FILE *file, uint8_t flags);
+
 // Parse and serialize the AST represented by the given source to the given
 // buffer.
 __attribute__((__visibility__("default"))) extern void
@@ -77,4 +164,10 @@ yp_token_type_to_str(yp_token_type_t token_type);
 __attribute__((__visibility__("default"))) extern yp_token_type_t
 yp_token_type_from_str(const char *str);
 
+// Returns the type of the keyword that the given identifier spells, or
+// YP_TOKEN_IDENTIFIER if it isn't one. This is generated from the keyword
+// tokens in config.yml.
+yp_token_type_t
+yp_keyword_token_type(const char *start, size_t length);
+
 #endif
@@ -0,0 +1,4 @@
+# comment
+"multi
+line
+string"
@@ -0,0 +1,4 @@
+foo
+
+
+bar = 1
\ No newline at end of file
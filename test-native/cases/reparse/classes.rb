@@ -0,0 +1,20 @@
+# frozen_string_literal: true
+
+module Foo
+  class Bar < Baz
+    def initialize(name, value = 1)
+      @name = name
+      @value = value
+    end
+
+    def to_s
+      "#{@name}: #{@value}"
+    end
+
+    class << self
+      def build
+        new("bar")
+      end
+    end
+  end
+end
@@ -0,0 +1,13 @@
+foo = 1
+bar = foo + 2
+baz
+
+def qux(a, b)
+  c = a
+  c + b
+  d
+end
+
+foo; bar
+baz = :sym
+baz
@@ -0,0 +1,15 @@
+class Strings
+  def one
+    'single'
+  end
+  def two
+    "double" # trailing comment
+  end
+  def three
+    %w[a b c]
+  end
+end
+=begin
+embedded
+=end
+puts Strings.new.two
@@ -10,4 +10,36 @@ for f in $(find test-native/cases/lexer -type f); do
     fi
 done
 
+for f in $(find test-native/cases/reparse -type f); do
+    ./test-native/run-one --reparse "$f" > /dev/null
+    if [ $? -ne 0 ]
+    then
+        exitcode=1
+    fi
+done
+
+for f in $(find test-native/cases/reparse -type f); do
+    ./test-native/run-one --serialize "$f" > /dev/null
+    if [ $? -ne 0 ]
+    then
+        exitcode=1
+    fi
+done
+
+for f in $(find test-native/cases/newlines test-native/cases/reparse -type f); do
+    ./test-native/run-one --newlines "$f" > /dev/null
+    if [ $? -ne 0 ]
+    then
+        exitcode=1
+    fi
+done
+
+for f in $(find test-native/cases/reparse -type f); do
+    ./test-native/run-one --cancel "$f" > /dev/null
+    if [ $? -ne 0 ]
+    then
+        exitcode=1
+    fi
+done
+
 exit $exitcode
@@ -179,12 +179,381 @@ run_parser(const char *filepath, const char *contents, size_t length) {
   return 0;
 }
 
+// Append bytes to the given buffer. This is kept here since the buffer functions
+// other than init and free aren't exported from the library.
+static void
+buffer_append(yp_buffer_t *buffer, const void *value, size_t length) {
+  if (buffer->length + length > buffer->capacity) {
+    buffer->capacity = (buffer->length + length) * 2;
+    buffer->value = realloc(buffer->value, buffer->capacity);
+  }
+
+  memcpy(buffer->value + buffer->length, value, length);
+  buffer->length += length;
+}
+
+// Serialize the tree along with the errors, comments, and starts of lines that
+// were found, so that the results of two parses can be compared.
+static void
+serialize_result(yp_parser_t *parser, yp_node_t *node, yp_buffer_t *buffer) {
+  yp_serialize(parser, node, buffer);
+
+  for (yp_list_node_t *error = parser->error_list.head; error != NULL; error = error->next) {
+    buffer_append(buffer, &error->start, sizeof(uint32_t));
+    buffer_append(buffer, yp_string_source(&((yp_error_t *) error)->message), yp_string_length(&((yp_error_t *) error)->message));
+  }
+
+  for (yp_list_node_t *comment = parser->comment_list.head; comment != NULL; comment = comment->next) {
+    buffer_append(buffer, &comment->start, sizeof(uint32_t));
+    buffer_append(buffer, &comment->end, sizeof(uint32_t));
+  }
+
+  buffer_append(buffer, parser->newline_list.offsets, parser->newline_list.size * sizeof(uint32_t));
+}
+
+// Parse the source from scratch and serialize the result.
+static void
+full_parse(const char *source, size_t length, yp_buffer_t *buffer) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, source, length);
+
+  yp_node_t *node = yp_parse(&parser);
+  serialize_result(&parser, node, buffer);
+
+  yp_node_destroy(&parser, node);
+  yp_parser_free(&parser);
+}
+
+// Apply the edit to the previous source, returning the new source.
+static char *
+apply_edit(const char *previous, size_t previous_length, const yp_edit_t *edit, const char *text, size_t *length) {
+  size_t suffix = previous_length - edit->old_end;
+  *length = edit->new_end + suffix;
+
+  char *source = malloc(*length + 1);
+  memcpy(source, previous, edit->start);
+  memcpy(source + edit->start, text, edit->new_end - edit->start);
+  memcpy(source + edit->new_end, previous + edit->old_end, suffix);
+  source[*length] = '\0';
+
+  return source;
+}
+
+// Make the given edit to the source, then reparse it incrementally and check
+// that the result matches a full parse. Then undo the edit and check that a
+// second reparse gets back to where it started.
+static int
+run_reparse_edit(const char *filepath, const char *source, size_t length, const char *expected, size_t expected_length, const yp_edit_t *edit, const char *text) {
+  yp_parser_t previous;
+  yp_parser_init(&previous, source, length);
+  yp_parser_enable_reparse(&previous);
+  yp_node_t *tree = yp_parse(&previous);
+
+  size_t edited_length;
+  char *edited = apply_edit(source, length, edit, text, &edited_length);
+
+  yp_parser_t parser;
+  yp_parser_init(&parser, edited, edited_length);
+  tree = yp_reparse(&parser, &previous, tree, edit);
+  yp_parser_free(&previous);
+
+  yp_buffer_t actual;
+  yp_buffer_init(&actual);
+  serialize_result(&parser, tree, &actual);
+
+  yp_buffer_t full;
+  yp_buffer_init(&full);
+  full_parse(edited, edited_length, &full);
+
+  int result = 0;
+  if (actual.length != full.length || memcmp(actual.value, full.value, full.length) != 0) {
+    red("%s: reparse after replacing %u..%u with \"%s\" did not match a full parse\n", filepath, edit->start, edit->old_end, text);
+    result = 1;
+  }
+
+  // Now undo the edit, starting from the tree that was just reparsed.
+  yp_edit_t undo = { .start = edit->start, .old_end = edit->new_end, .new_end = edit->old_end };
+  size_t undone_length;
+  char *undone = apply_edit(edited, edited_length, &undo, source + edit->start, &undone_length);
+
+  yp_parser_t reparser;
+  yp_parser_init(&reparser, undone, undone_length);
+  tree = yp_reparse(&reparser, &parser, tree, &undo);
+  yp_parser_free(&parser);
+  free(edited);
+
+  yp_buffer_t undone_actual;
+  yp_buffer_init(&undone_actual);
+  serialize_result(&reparser, tree, &undone_actual);
+
+  if (result == 0 && (undone_actual.length != expected_length || memcmp(undone_actual.value, expected, expected_length) != 0)) {
+    red("%s: reparse after undoing the replacement of %u..%u with \"%s\" did not match a full parse\n", filepath, edit->start, edit->old_end, text);
+    result = 1;
+  }
+
+  yp_node_destroy(&reparser, tree);
+  yp_parser_free(&reparser);
+  free(undone);
+
+  yp_buffer_free(&undone_actual);
+  yp_buffer_free(&full);
+  yp_buffer_free(&actual);
+  return result;
+}
+
+// Type and delete a character in the middle of the file over and over, each
+// time reparsing from the previous parse. Every reparse holds on to the memory
+// of the nodes it replaced, so check that the memory held stays bounded by
+// what a full parse takes (twice that before parsing from scratch, plus what
+// one more reparse can allocate), and that the result still matches a full
+// parse at the end.
+static int
+run_reparse_chain(const char *filepath, const char *contents, size_t length, const char *expected, size_t expected_length) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, contents, length);
+  yp_parser_enable_reparse(&parser);
+  yp_node_t *tree = yp_parse(&parser);
+
+  size_t bound = 3 * parser.arena.size + YP_ARENA_BLOCK_SIZE;
+  size_t most = parser.arena.size;
+
+  uint32_t offset = (uint32_t) (length / 2);
+  yp_edit_t insert = { .start = offset, .old_end = offset, .new_end = offset + 1 };
+  yp_edit_t delete = { .start = offset, .old_end = offset + 1, .new_end = offset };
+
+  char *source = NULL;
+  size_t source_length = length;
+
+  for (int edit = 0; edit < 1000; edit++) {
+    const yp_edit_t *current = edit % 2 == 0 ? &insert : &delete;
+    char *edited = apply_edit(source == NULL ? contents : source, source_length, current, "x", &source_length);
+
+    yp_parser_t reparser;
+    yp_parser_init(&reparser, edited, source_length);
+    tree = yp_reparse(&reparser, &parser, tree, current);
+    yp_parser_free(&parser);
+    free(source);
+
+    parser = reparser;
+    source = edited;
+    if (parser.arena.size > most) most = parser.arena.size;
+  }
+
+  int result = 0;
+  if (most > bound) {
+    red("%s: reparsing 1000 times held %zu bytes of nodes, more than the bound of %zu\n", filepath, most, bound);
+    result = 1;
+  }
+
+  yp_buffer_t actual;
+  yp_buffer_init(&actual);
+  serialize_result(&parser, tree, &actual);
+
+  if (result == 0 && (actual.length != expected_length || memcmp(actual.value, expected, expected_length) != 0)) {
+    red("%s: reparsing 1000 times did not match a full parse\n", filepath);
+    result = 1;
+  }
+
+  yp_buffer_free(&actual);
+  yp_node_destroy(&parser, tree);
+  yp_parser_free(&parser);
+  free(source);
+  return result;
+}
+
+// Insert and delete text at every offset of the file, and check that
+// reparsing incrementally always gives the same result as a full parse.
+static int
+run_reparse(const char *filepath, const char *contents, size_t length) {
+  static const char *insertions[] = { "x", "\n", " ", "=", "end", "\nend\n", "foo = 1\n", "#", "\"" };
+
+  yp_buffer_t expected;
+  yp_buffer_init(&expected);
+  full_parse(contents, length, &expected);
+
+  int result = run_reparse_chain(filepath, contents, length, expected.value, expected.length);
+  for (uint32_t offset = 0; offset <= length && result == 0; offset++) {
+    for (size_t index = 0; index < sizeof(insertions) / sizeof(insertions[0]) && result == 0; index++) {
+      yp_edit_t edit = { .start = offset, .old_end = offset, .new_end = offset + (uint32_t) strlen(insertions[index]) };
+      result = run_reparse_edit(filepath, contents, length, expected.value, expected.length, &edit, insertions[index]);
+    }
+
+    for (uint32_t width = 1; width <= 4 && offset + width <= length && result == 0; width++) {
+      yp_edit_t edit = { .start = offset, .old_end = offset + width, .new_end = offset };
+      result = run_reparse_edit(filepath, contents, length, expected.value, expected.length, &edit, "");
+    }
+  }
+
+  yp_buffer_free(&expected);
+  return result;
+}
+
+// A sink that appends every chunk to a buffer, checking that each one except
+// the last is a full chunk.
+typedef struct {
+  yp_buffer_t buffer;
+  bool short_chunk;
+} chunks_t;
+
+static bool
+chunks_write(yp_serialize_sink_t *sink, const char *bytes, size_t length) {
+  chunks_t *chunks = (chunks_t *) sink->data;
+
+  if (chunks->short_chunk) return false;
+  if (length != sink->chunk_size) chunks->short_chunk = true;
+
+  buffer_append(&chunks->buffer, bytes, length);
+  return true;
+}
+
+// A sink that fails to write its first chunk, and counts how many times it was
+// asked to write.
+static bool
+failing_write(yp_serialize_sink_t *sink, const char *bytes, size_t length) {
+  (*((size_t *) sink->data))++;
+  return false;
+}
+
+// Serialize the file to sinks with a range of chunk sizes, and check that the
+// result is always the same as serializing it to an empty buffer. Then check
+// that serializing after something else in a buffer gives the same bytes, and
+// that serializing stops as soon as a sink fails.
+static int
+run_serialize(const char *filepath, const char *contents, size_t length) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, contents, length);
+  yp_node_t *node = yp_parse(&parser);
+
+  int result = 0;
+  for (uint8_t flags = 0; flags <= YP_SERIALIZE_NEWLINES && result == 0; flags++) {
+    yp_buffer_t expected;
+    yp_buffer_init(&expected);
+    yp_serialize_with_flags(&parser, node, &expected, flags);
+
+    yp_buffer_t appended;
+    yp_buffer_init(&appended);
+    buffer_append(&appended, "prefix", 6);
+    yp_serialize_with_flags(&parser, node, &appended, flags);
+
+    if (appended.length != expected.length + 6 || memcmp(appended.value + 6, expected.value, expected.length) != 0) {
+      red("%s: serializing after a prefix in the buffer did not match serializing to an empty buffer\n", filepath);
+      result = 1;
+    }
+
+    yp_buffer_free(&appended);
+
+    for (size_t chunk_size = 1; chunk_size <= expected.length + 1 && result == 0; chunk_size += chunk_size < 16 ? 1 : 7) {
+      chunks_t chunks = { .buffer = { .value = NULL, .length = 0, .capacity = 0 }, .short_chunk = false };
+      yp_serialize_sink_t sink = { .write = chunks_write, .data = &chunks, .chunk_size = chunk_size };
+
+      if (!yp_serialize_to_sink(&parser, node, &sink, flags)) {
+        red("%s: serializing in chunks of %zu bytes wrote a short chunk before the last one\n", filepath, chunk_size);
+        result = 1;
+      } else if (chunks.buffer.length != expected.length || memcmp(chunks.buffer.value, expected.value, expected.length) != 0) {
+        red("%s: serializing in chunks of %zu bytes did not match serializing to a buffer\n", filepath, chunk_size);
+        result = 1;
+      }
+
+      free(chunks.buffer.value);
+    }
+
+    size_t writes = 0;
+    yp_serialize_sink_t failing = { .write = failing_write, .data = &writes, .chunk_size = 1 };
+
+    if (result == 0 && (yp_serialize_to_sink(&parser, node, &failing, flags) || writes != 1)) {
+      red("%s: serializing to a failing sink wrote %zu chunks instead of stopping after the first\n", filepath, writes);
+      result = 1;
+    }
+
+    yp_buffer_free(&expected);
+  }
+
+  yp_node_destroy(&parser, node);
+  yp_parser_free(&parser);
+  return result;
+}
+
+// Check the line and column of every offset in the file, and of a few offsets
+// past the end of it, against counting the newlines before each offset by
+// hand. Offsets past the end of the file are on the last line.
+static int
+run_newlines(const char *filepath, const char *contents, size_t length) {
+  yp_parser_t parser;
+  yp_parser_init(&parser, contents, length);
+  yp_node_t *node = yp_parse(&parser);
+
+  size_t line = 1;
+  size_t line_start = 0;
+  int result = 0;
+
+  for (size_t offset = 0; offset <= length + 2 && result == 0; offset++) {
+    if (offset > 0 && offset <= length && contents[offset - 1] == '\n') {
+      line++;
+      line_start = offset;
+    }
+
+    yp_line_column_t actual = yp_newline_list_line_column(&parser.newline_list, (uint32_t) offset);
+    if (actual.line != line || actual.column != offset - line_start) {
+      red("%s: offset %zu was at %zu:%zu instead of %zu:%zu\n", filepath, offset, actual.line, actual.column, line, offset - line_start);
+      result = 1;
+    }
+  }
+
+  yp_node_destroy(&parser, node);
+  yp_parser_free(&parser);
+  return result;
+}
+
+// Cancel lexing the file after each number of tokens in turn, and check that
+// every token after that is the end of the file. Then check that a parser that
+// was cancelled before it started still returns a tree.
+static int
+run_cancel(const char *filepath, const char *contents, size_t length) {
+  yp_parser_t parser;
+  int result = 0;
+
+  for (size_t cancel_at = 0, tokens = 1; cancel_at <= tokens && result == 0; cancel_at++) {
+    yp_parser_init(&parser, contents, length);
+    tokens = 0;
+
+    do {
+      if (tokens == cancel_at) yp_parser_cancel(&parser);
+      yp_lex_token(&parser);
+      tokens++;
+
+      if (tokens > cancel_at && parser.current.type != YP_TOKEN_EOF) {
+        red("%s: lexed a token after being cancelled after %zu tokens\n", filepath, cancel_at);
+        result = 1;
+      }
+    } while (parser.current.type != YP_TOKEN_EOF && result == 0);
+
+    yp_parser_free(&parser);
+  }
+
+  yp_parser_init(&parser, contents, length);
+  yp_parser_cancel(&parser);
+
+  yp_node_t *node = yp_parse(&parser);
+  if (result == 0 && node == NULL) {
+    red("%s: parsing after being cancelled did not return a tree\n", filepath);
+    result = 1;
+  }
+
+  yp_node_destroy(&parser, node);
+  yp_parser_free(&parser);
+  return result;
+}
+
 int
 main(int argc, char **argv) {
   if (argc != 3) {
     fprintf(stderr, "Usage:\n\n"
                     "./run-one --lexer path/to/lexer/test\n"
-                    "./run-one --parser path/to/parser/test\n");
+                    "./run-one --parser path/to/parser/test\n"
+                    "./run-one --reparse path/to/reparse/test\n"
+                    "./run-one --serialize path/to/ruby/source\n"
+                    "./run-one --newlines path/to/ruby/source\n"
+                    "./run-one --cancel path/to/ruby/source\n");
     return 1;
   }
 
@@ -195,8 +564,16 @@ main(int argc, char **argv) {
     exitcode = run_lexer(f.filepath);
   } else if (strcmp(argv[1], "--parser") == 0) {
     exitcode = run_parser(f.filepath, f.contents, f.length);
+  } else if (strcmp(argv[1], "--reparse") == 0) {
+    exitcode = run_reparse(f.filepath, f.contents, f.length);
+  } else if (strcmp(argv[1], "--serialize") == 0) {
+    exitcode = run_serialize(f.filepath, f.contents, f.length);
+  } else if (strcmp(argv[1], "--newlines") == 0) {
+    exitcode = run_newlines(f.filepath, f.contents, f.length);
+  } else if (strcmp(argv[1], "--cancel") == 0) {
+    exitcode = run_cancel(f.filepath, f.contents, f.length);
   } else {
-    fprintf(stderr, "--lexer or --parser mode must be provided, given: %s\n", argv[1]);
+    fprintf(stderr, "--lexer, --parser, --reparse, --serialize, --newlines, or --cancel mode must be provided, given: %s\n", argv[1]);
     exitcode = 1;
   }
 
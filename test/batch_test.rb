@@ -0,0 +1,43 @@
+# frozen_string_literal: true
+
+require "test_helper"
+
+class BatchTest < Test::Unit::TestCase
+  test "parse_files" do
+    filepaths = Dir[File.expand_path("*.rb", __dir__)]
+    results = YARP.parse_files(filepaths, threads: 2)
+
+    assert_equal filepaths.length, results.length
+    filepaths.zip(results).each do |filepath, result|
+      assert_equal YARP.parse_file(filepath).node, result.node
+      assert_equal YARP.parse_file(filepath).errors.length, result.errors.length
+    end
+  end
+
+  test "dump_files" do
+    filepaths = Dir[File.expand_path("*.rb", __dir__)]
+    assert_equal filepaths.map { |filepath| YARP.dump_file(filepath) }, YARP.dump_files(filepaths)
+  end
+
+  test "parse_files and dump_files with paths that convert to strings" do
+    filepath = File.expand_path("batch_test.rb", __dir__)
+    path = Object.new
+    path.define_singleton_method(:to_str) { filepath.dup }
+
+    assert_equal YARP.dump_file(filepath), YARP.dump_files([path]).first
+    assert_kind_of YARP::ParseResult, YARP.parse_files([path]).first
+  end
+
+  test "parse_files with a missing file" do
+    # The extension reports the failure to open the file with perror, so
+    # silence stderr at the file descriptor level while it runs.
+    stderr = STDERR.dup
+    STDERR.reopen(File::NULL)
+
+    begin
+      assert_equal [nil], YARP.parse_files([File.expand_path("missing.rb", __dir__)])
+    ensure
+      STDERR.reopen(stderr)
+    end
+  end
+end
@@ -0,0 +1,100 @@
+# frozen_string_literal: true
+
+require "test_helper"
+require "tempfile"
+require "tmpdir"
+
+class CacheTest < Test::Unit::TestCase
+  test "dump matches an uncached dump" do
+    with_cache do |cache|
+      source = "foo.bar(baz)\n"
+
+      assert_equal YARP.dump(source), cache.dump(source)
+      assert_path_exist cache.path_for(source)
+      assert_equal YARP.dump(source), cache.dump(source)
+    end
+  end
+
+  test "dump_file reads entries written for the same contents" do
+    with_cache do |cache|
+      source = "foo = 1\nfoo\n"
+      write_entry(cache, source, YARP.dump("bar\n"))
+
+      Tempfile.create(["cache", ".rb"]) do |file|
+        file.write(source)
+        file.close
+
+        assert_equal YARP.dump("bar\n"), cache.dump_file(file.path)
+      end
+    end
+  end
+
+  test "cached entries are mapped" do
+    with_cache do |cache|
+      source = "foo.bar(baz)\n"
+      cache.dump(source)
+
+      serialized = cache.dump(source)
+      assert_predicate serialized, :frozen?
+      assert_equal Encoding::BINARY, serialized.encoding
+
+      # Strings that share the mapped contents have to keep the mapping alive.
+      copy = serialized.dup
+      slice = serialized.byteslice(1..)
+      serialized = nil
+      GC.start
+
+      assert_equal YARP.dump(source), copy
+      assert_equal YARP.dump(source).byteslice(1..), slice
+    end
+  end
+
+  test "entries that can't be read are ignored" do
+    with_cache do |cache|
+      source = "foo\n"
+      FileUtils.mkdir_p(cache.path_for(source))
+
+      assert_equal YARP.dump(source), cache.dump(source)
+    end
+
+    with_cache do |cache|
+      source = "foo\n"
+      File.write(File.join(cache.directory, YARP::VERSION), "")
+
+      assert_equal YARP.dump(source), cache.dump(source)
+    end
+  end
+
+  test "entries from another version are ignored" do
+    with_cache do |cache|
+      source = "foo\n"
+      write_entry(cache, source, "YARP\0\0\0")
+
+      assert_equal YARP.dump(source), cache.dump(source)
+    end
+  end
+
+  test "load_file" do
+    with_cache do |cache|
+      Tempfile.create(["cache", ".rb"]) do |file|
+        file.write("foo.bar\n")
+        file.close
+
+        assert_equal YARP.load("foo.bar\n", YARP.dump("foo.bar\n")), cache.load_file(file.path)
+        assert_equal YARP.load("foo.bar\n", YARP.dump("foo.bar\n")), cache.load_file(file.path, lazy: true)
+      end
+    end
+  end
+
+  private
+
+  def with_cache
+    Dir.mktmpdir { |directory| yield YARP::Cache.new(directory) }
+  end
+
+  def write_entry(cache, source, serialized)
+    path = cache.path_for(source)
+    FileUtils.mkdir_p(File.dirname(path))
+    File.binwrite(path, serialized)
+  end
+end
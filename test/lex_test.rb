@@ -19,6 +19,24 @@ class LexTest < Test::Unit::TestCase
     assert_lex __FILE__
   end
 
+  test "lex_packed matches lex" do
+    source = File.read(File.expand_path("fixtures/lex.rb", __dir__))
+    packed = YARP.lex_packed(source).unpack("L*").each_slice(3).map do |type, start_offset, end_offset|
+      [YARP::TOKEN_TYPES[type], start_offset, end_offset]
+    end
+
+    expected = YARP.lex(source).map do |token|
+      [token.type, token.location.start_offset, token.location.end_offset]
+    end
+
+    assert_equal expected, packed
+    assert_equal YARP.lex_packed(source), YARP.lex_file_packed(File.expand_path("fixtures/lex.rb", __dir__))
+
+    packed, newlines = YARP.lex_packed_with_newlines(source)
+    assert_equal YARP.lex_packed(source), packed
+    assert_equal YARP.parse(source).newlines.offsets, newlines.offsets
+  end
+
   private
 
   def assert_lex(filepath)
@@ -1,6 +1,9 @@
 # frozen_string_literal: true
 
 require "test_helper"
+require "tempfile"
+require "timeout"
+require "tmpdir"
 
 class ParseTest < Test::Unit::TestCase
   include YARP::DSL
@@ -32,6 +35,48 @@ class ParseTest < Test::Unit::TestCase
     YARP.parse(source) => YARP::ParseResult[comments: [YARP::Comment[type: :embdoc]]]
   end
 
+  test "newlines" do
+    source = "foo\n\n<<~HEREDOC\n  bar\nHEREDOC\n# baz\n__END__\nqux\n"
+    expected = [0]
+    source.each_line { |line| expected << expected.last + line.bytesize }
+
+    assert_equal expected, YARP.parse(source).newlines.offsets
+    assert_equal expected, YARP.parse_lazy(source).newlines.offsets
+  end
+
+  test "newlines line and column" do
+    source = "foo\nbarbaz\n\nqux"
+    newlines = YARP.parse(source).newlines
+
+    expected = [
+      [1, 0], [1, 1], [1, 2], [1, 3],
+      [2, 0], [2, 1], [2, 2], [2, 3], [2, 4], [2, 5], [2, 6],
+      [3, 0],
+      [4, 0], [4, 1], [4, 2]
+    ]
+
+    # Both in order, which follows the cursor, and backwards, which searches.
+    assert_equal expected, (0...source.bytesize).map { |offset| newlines.line_column(offset) }
+    assert_equal expected.reverse, (0...source.bytesize).reverse_each.map { |offset| newlines.line_column(offset) }
+
+    assert_equal 2, newlines.line(7)
+    assert_equal 3, newlines.column(7)
+  end
+
+  test "serialized newlines" do
+    source = "foo\n\nbar(baz)\n# qux\n"
+
+    assert_nil YARP.load_newlines(YARP.dump(source))
+    assert_equal YARP.parse(source).newlines.offsets, YARP.load_newlines(YARP.dump(source, newlines: true)).offsets
+
+    Tempfile.create(["newlines", ".rb"]) do |file|
+      file.write(source)
+      file.flush
+
+      assert_equal YARP.dump(source, newlines: true), YARP.dump_file(file.path, newlines: true)
+    end
+  end
+
   test "alias bare" do
     expected = AliasNode(
       KEYWORD_ALIAS("alias"),
@@ -609,6 +654,39 @@ class ParseTest < Test::Unit::TestCase
     assert_parses expected, "def a **\nend"
   end
 
+  test "def with keyword parameter read in the body" do
+    expected = DefNode(
+      KEYWORD_DEF("def"),
+      IDENTIFIER("a"),
+      nil,
+      ParametersNode([], [], nil, [KeywordParameterNode(LABEL("b:"))], nil, nil),
+      nil,
+      nil,
+      Statements([LocalVariableRead(IDENTIFIER("b"))]),
+      KEYWORD_END("end"),
+      Scope([LABEL("b")])
+    )
+
+    assert_parses expected, "def a b:\nb\nend"
+  end
+
+  test "def with keyword parameter doesn't resolve other names" do
+    expected = DefNode(
+      KEYWORD_DEF("def"),
+      IDENTIFIER("a"),
+      nil,
+      ParametersNode([], [], nil, [KeywordParameterNode(LABEL("b:"))], nil, nil),
+      nil,
+      nil,
+      Statements([CallNode(nil, nil, IDENTIFIER("bc"), nil, nil, nil, "bc")]),
+      KEYWORD_END("end"),
+      Scope([LABEL("b")])
+    )
+
+    assert_parses expected, "def a b:\nbc\nend"
+    assert_parses CallNode(nil, nil, IDENTIFIER("b"), nil, nil, nil, "b"), "def a b:\nend\nb"
+  end
+
   test "def with forwarding parameter" do
     expected = DefNode(
       KEYWORD_DEF("def"),
@@ -696,6 +774,12 @@ class ParseTest < Test::Unit::TestCase
     assert_parses CallNode(nil, nil, IDENTIFIER("a"), nil, nil, nil, "a"), "a"
   end
 
+  test "identifier with non-ASCII characters" do
+    ["café", "переменная", "変数"].each do |name|
+      assert_equal CallNode(nil, nil, IDENTIFIER(name.b), nil, nil, nil, name.b), expression(name)
+    end
+  end
+
   test "if" do
     assert_parses IfNode(KEYWORD_IF("if"), expression("true"), Statements([expression("1")]), nil, KEYWORD_END("end")), "if true; 1; end"
   end
@@ -760,6 +844,14 @@ class ParseTest < Test::Unit::TestCase
     assert_parses InstanceVariableWrite(INSTANCE_VARIABLE("@abc"), EQUAL("="), expression("1")), "@abc = 1"
   end
 
+  test "local variable read" do
+    assert_parses LocalVariableRead(IDENTIFIER("abc")), "abc = 1; abc"
+  end
+
+  test "local variable read only matches whole names" do
+    assert_parses CallNode(nil, nil, IDENTIFIER("ab"), nil, nil, nil, "ab"), "abc = 1; ab"
+  end
+
   test "local variable write" do
     assert_parses LocalVariableWrite(IDENTIFIER("abc"), EQUAL("="), expression("1")), "abc = 1"
   end
@@ -1444,17 +1536,128 @@ class ParseTest < Test::Unit::TestCase
     assert_parses expected, "for i,j,k in 1..10\ni\nend"
   end
 
+  test "parses on multiple threads" do
+    source = "foo = 1\nfoo.bar(baz)\n" * 100
+    expected = YARP.dump(source)
+
+    threads = 4.times.map { Thread.new { 10.times.map { [YARP.dump(source), YARP.parse(source).node, YARP.lex(source).length] } } }
+    threads.map(&:value).flatten(1).each do |(dumped, node, size)|
+      assert_equal expected, dumped
+      assert_equal YARP.parse(source).node, node
+      assert_equal YARP.lex(source).length, size
+    end
+  end
+
+  test "map_file" do
+    Tempfile.create(["map", ".rb"]) do |file|
+      file.write("foo\n")
+      file.close
+
+      assert_equal "foo\n", YARP.map_file(file.path)
+      assert_predicate YARP.map_file(file.path), :frozen?
+    end
+
+    Tempfile.create(["map", ".rb"]) do |file|
+      assert_equal "", YARP.map_file(file.path)
+    end
+
+    assert_raise(Errno::ENOENT) { YARP.map_file(File.expand_path("missing.rb", __dir__)) }
+    assert_raise(Errno::EISDIR) { YARP.map_file(__dir__) }
+  end
+
+  test "dump into a string that has to grow or shrink" do
+    # The tree for the first one is several times larger than the source and
+    # the tree for the second one is a fraction of it.
+    sources = ["foo = bar(1, 2)\n" * 10_000, "# comment\n" * 10_000]
+
+    Dir.mktmpdir do |directory|
+      filepaths =
+        sources.each_with_index.map do |source, index|
+          filepath = File.join(directory, "#{index}.rb")
+          File.write(filepath, source)
+          filepath
+        end
+
+      expected = YARP.dump_files(filepaths)
+      assert_equal expected, sources.map { |source| YARP.dump(source) }
+      assert_equal expected, filepaths.map { |filepath| YARP.dump_file(filepath) }
+    end
+  end
+
+  test "locations" do
+    YARP.parse("foo.bar\n") => YARP::ParseResult[node: YARP::Program[statements: YARP::Statements[body: [node]]]]
+
+    assert_equal [0, 7], [node.location.start_offset, node.location.end_offset]
+    assert_equal [4, 7], [node.message.location.start_offset, node.message.location.end_offset]
+    assert_same node.location, node.location
+  end
+
+  test "parse_file_lazy" do
+    filepath = File.expand_path("version_test.rb", __dir__)
+    assert_equal YARP.parse_file(filepath).node, YARP.parse_file_lazy(filepath).node
+  end
+
+  test "lazy nodes outlive their result" do
+    node = YARP.parse_lazy(+"foo.bar(baz)\n").node
+    GC.start
+
+    assert_equal YARP.parse("foo.bar(baz)\n").node, node
+  end
+
+  test "lazy trees check the positions they're given" do
+    tree = YARP.parse_lazy("foo(1)").node.instance_variable_get(:@loader)
+    assert_raise(NoMethodError) { tree.load_fields(0, 8, 0) }
+
+    [-1, 8, 1 << 40].each do |position|
+      assert_raise(ArgumentError) { tree.__send__(:load_fields, 0, position, 0) }
+    end
+
+    assert_raise(ArgumentError) { tree.__send__(:load_fields, 1, 0, 0) }
+  end
+
+  test "deeply nested trees" do
+    depth = 100_000
+    source = "1" + " + 1" * depth
+
+    assert_operator YARP.dump(source).bytesize, :>, depth
+
+    node = expression(source)
+    depth.times { node = node.receiver }
+    assert_kind_of YARP::IntegerLiteral, node
+  end
+
+  test "interrupting while the GVL is released" do
+    source = "foo(bar, baz)\n" * 1_000_000
+
+    [:dump, :lex, :lex_packed, :parse, :parse_lazy].each do |method|
+      started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      assert_raise(Timeout::Error) { Timeout.timeout(0.05) { YARP.public_send(method, source) } }
+
+      elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - started
+      assert_operator elapsed, :<, 0.5, "YARP.#{method} wasn't stopped by the interrupt"
+    end
+  end
+
   private
 
   def assert_serializes(expected, source)
     YARP.load(source, YARP.dump(source)) => YARP::Program[statements: YARP::Statements[body: [*, node]]]
     assert_equal expected, node
+
+    YARP.load_lazy(source, YARP.dump(source)) => YARP::Program[statements: YARP::Statements[body: [*, node]]]
+    assert_equal expected, node
+
+    YARP.load(source, YARP.dump(source, newlines: true)) => YARP::Program[statements: YARP::Statements[body: [*, node]]]
+    assert_equal expected, node
   end
 
   def assert_parses(expected, source)
     assert_equal expected, expression(source)
     assert_serializes expected, source
 
+    YARP.parse_lazy(source) => YARP::ParseResult[node: YARP::Program[statements: YARP::Statements[body: [*, node]]]]
+    assert_equal expected, node
+
     YARP.lex_ripper(source).zip(YARP.lex_compat(source)).each do |(ripper, yarp)|
       assert_equal ripper[0...-1], yarp[0...-1]
     end